@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <omp.h>
+#include "batch.h"
+#include "input.h"
+#include "goi.h"
+#include "profile.h"
+
+/**
+ * Jobs whose worlds have fewer cells than this are too small to keep a whole team of threads busy between
+ * the per-generation barriers. They are packed onto single threads and run side by side instead.
+ */
+#define BATCH_SMALL_JOB_CELLS (256 * 256)
+
+typedef struct
+{
+    char *inputPath;
+    char *outputPath;
+    int nGenerations;
+    int nRows;
+    int nCols;
+    long cells;
+    long work; // cells * generations, used to hand out the longest jobs first
+} BatchJob;
+
+static int readManifest(const char *manifestPath, BatchJob **jobs, int *nJobs);
+static int runJob(const BatchJob *job, GoiContext **ctx, const GoiOptions *options, bool fixedRules);
+static int runInput(const BatchJob *job, GoiInput *input, GoiContext **ctx, const GoiOptions *jobOptions);
+static int compareJobsByWork(const void *a, const void *b);
+static int compareJobsByShape(const void *a, const void *b);
+static void freeJobs(BatchJob *jobs, int nJobs);
+static int readJobInput(const BatchJob *job, GoiInput *input, const GoiOptions *options, bool fixedRules, GoiOptions *jobOptions);
+static int writeJobOutput(const BatchJob *job, long warDeathToll);
+static int runEnsemble(BatchJob **jobs, GoiInput *inputs, int nWorlds, const GoiOptions *options);
+
+/**
+ * Runs every (input, output) pair listed in the manifest at manifestPath inside this one process.
+ *
+ * The manifest has one job per line: an input path and an output path separated by whitespace. Blank lines
+ * and lines starting with '#' are ignored.
+ *
+ * Each job is simulated with options, except that the job's own rules (if its input has any) take precedence
+ * unless fixedRules is set. Large jobs are run one after another with options->nThreads threads. Small jobs are then spread over the same
+ * team, one job per thread at a time, each thread resetting one simulation context from job to job so that
+ * its world buffers are reused.
+ *
+ * Returns the number of jobs that failed, or -1 if the manifest itself could not be read.
+ */
+int runBatch(const char *manifestPath, const GoiOptions *options, bool fixedRules)
+{
+    BatchJob *jobs;
+    int nJobs;
+    if (readManifest(manifestPath, &jobs, &nJobs) == -1)
+    {
+        return -1;
+    }
+
+    // large jobs first, then the longest small jobs so that the packed phase does not end with one thread
+    // chewing on a big job alone
+    qsort(jobs, nJobs, sizeof(BatchJob), compareJobsByWork);
+
+    int nFailed = 0;
+    int nLarge = 0;
+    GoiContext *ctx = NULL;
+    while (nLarge < nJobs && jobs[nLarge].cells >= BATCH_SMALL_JOB_CELLS)
+    {
+        if (runJob(&jobs[nLarge], &ctx, options, fixedRules) == -1)
+        {
+            nFailed++;
+        }
+        nLarge++;
+    }
+    goi_destroy(ctx);
+
+    GoiOptions packedOptions = *options;
+    packedOptions.nThreads = 1;
+    #pragma omp parallel num_threads(options->nThreads) reduction(+:nFailed)
+    {
+        GoiContext *threadCtx = NULL;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = nLarge; i < nJobs; i++)
+        {
+            if (runJob(&jobs[i], &threadCtx, &packedOptions, fixedRules) == -1)
+            {
+                nFailed++;
+            }
+        }
+
+        goi_destroy(threadCtx);
+    }
+
+    printf("Batch: %d jobs (%d packed), %d failed\n", nJobs, nJobs - nLarge, nFailed);
+
+    freeJobs(jobs, nJobs);
+    return nFailed;
+}
+
+/**
+ * Runs every job in the manifest at manifestPath, as runBatch does, but advances jobs of the same dimensions,
+ * generations and rules together in ensembles of up to GOI_ENSEMBLE_MAX_WORLDS (see goi_ensemble_create).
+ * Each ensemble uses options->nThreads threads.
+ *
+ * Returns the number of jobs that failed, or -1 if the manifest itself could not be read.
+ */
+int runEnsembleBatch(const char *manifestPath, const GoiOptions *options, bool fixedRules)
+{
+    BatchJob *jobs;
+    int nJobs;
+    if (readManifest(manifestPath, &jobs, &nJobs) == -1)
+    {
+        return -1;
+    }
+    qsort(jobs, nJobs, sizeof(BatchJob), compareJobsByShape);
+
+    int nFailed = 0;
+    int nEnsembles = 0;
+    GoiContext *ctx = NULL;
+    GoiInput inputs[GOI_ENSEMBLE_MAX_WORLDS];
+    GoiOptions jobOptions[GOI_ENSEMBLE_MAX_WORLDS];
+    BatchJob *members[GOI_ENSEMBLE_MAX_WORLDS];
+    for (int first = 0; first < nJobs;)
+    {
+        // read the next run of up to GOI_ENSEMBLE_MAX_WORLDS jobs of the same shape
+        int nRead = 0;
+        int last = first;
+        while (last < nJobs && nRead < GOI_ENSEMBLE_MAX_WORLDS && compareJobsByShape(&jobs[first], &jobs[last]) == 0)
+        {
+            if (readJobInput(&jobs[last], &inputs[nRead], options, fixedRules, &jobOptions[nRead]) == -1)
+            {
+                nFailed++;
+            }
+            else if (inputs[nRead].nRows != jobs[first].nRows || inputs[nRead].nCols != jobs[first].nCols ||
+                     inputs[nRead].nGenerations != jobs[first].nGenerations)
+            {
+                // the file changed since its header was read
+                fprintf(stderr, "Failed to simulate %s.\n", jobs[last].inputPath);
+                freeInput(&inputs[nRead]);
+                nFailed++;
+            }
+            else
+            {
+                members[nRead++] = &jobs[last];
+            }
+            last++;
+        }
+        first = last;
+
+        // split the run by rules; most runs share one set and make a single ensemble
+        bool done[GOI_ENSEMBLE_MAX_WORLDS] = {false};
+        for (int i = 0; i < nRead; i++)
+        {
+            if (done[i])
+            {
+                continue;
+            }
+            GoiInput ensembleInputs[GOI_ENSEMBLE_MAX_WORLDS];
+            BatchJob *ensembleJobs[GOI_ENSEMBLE_MAX_WORLDS];
+            int nWorlds = 0;
+            for (int j = i; j < nRead; j++)
+            {
+                if (!done[j] && memcmp(&jobOptions[i].rules, &jobOptions[j].rules, sizeof(GoiRules)) == 0)
+                {
+                    ensembleInputs[nWorlds] = inputs[j];
+                    ensembleJobs[nWorlds++] = members[j];
+                    done[j] = true;
+                }
+            }
+            // a lone world would pay for a whole vector of lanes; it is cheaper on its own
+            if (nWorlds == 1)
+            {
+                nFailed += runInput(ensembleJobs[0], &ensembleInputs[0], &ctx, &jobOptions[i]) == -1;
+            }
+            else
+            {
+                nFailed += runEnsemble(ensembleJobs, ensembleInputs, nWorlds, &jobOptions[i]);
+                nEnsembles++;
+            }
+        }
+        for (int i = 0; i < nRead; i++)
+        {
+            freeInput(&inputs[i]);
+        }
+    }
+
+    goi_destroy(ctx);
+    printf("Batch: %d jobs (%d ensembles), %d failed\n", nJobs, nEnsembles, nFailed);
+
+    freeJobs(jobs, nJobs);
+    return nFailed;
+}
+
+/**
+ * Simulates nWorlds already read inputs as one ensemble and writes each job's output. Returns the number of
+ * jobs that failed.
+ */
+static int runEnsemble(BatchJob **jobs, GoiInput *inputs, int nWorlds, const GoiOptions *options)
+{
+    int *startWorlds[GOI_ENSEMBLE_MAX_WORLDS];
+    int nInvasions[GOI_ENSEMBLE_MAX_WORLDS];
+    int *invasionTimes[GOI_ENSEMBLE_MAX_WORLDS];
+    int **invasionPlans[GOI_ENSEMBLE_MAX_WORLDS];
+    for (int k = 0; k < nWorlds; k++)
+    {
+        startWorlds[k] = inputs[k].startWorld;
+        nInvasions[k] = inputs[k].nInvasions;
+        invasionTimes[k] = inputs[k].invasionTimes;
+        invasionPlans[k] = inputs[k].invasionPlans;
+    }
+
+    GoiEnsemble *ensemble = goi_ensemble_create(options, nWorlds, inputs[0].nRows, inputs[0].nCols, startWorlds, nInvasions,
+                                                invasionTimes, invasionPlans);
+    if (ensemble == NULL || goi_ensemble_step(ensemble, inputs[0].nGenerations) == -1)
+    {
+        for (int k = 0; k < nWorlds; k++)
+        {
+            fprintf(stderr, "Failed to simulate %s.\n", jobs[k]->inputPath);
+        }
+        goi_ensemble_destroy(ensemble);
+        return nWorlds;
+    }
+
+    int nFailed = 0;
+    for (int k = 0; k < nWorlds; k++)
+    {
+        if (writeJobOutput(jobs[k], goi_ensemble_death_toll(ensemble, k)) == -1)
+        {
+            nFailed++;
+        }
+    }
+    goi_ensemble_destroy(ensemble);
+    return nFailed;
+}
+
+/**
+ * Parses the manifest into a newly allocated array of jobs. Jobs whose input header cannot be read are kept
+ * (as small jobs) so that they are reported as failures when run.
+ *
+ * -1 is returned on error.
+ */
+static int readManifest(const char *manifestPath, BatchJob **jobs, int *nJobs)
+{
+    FILE *fp = fopen(manifestPath, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for reading.\n", manifestPath);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    int capacity = 0;
+    int lineNumber = 0;
+    *jobs = NULL;
+    *nJobs = 0;
+    while (getline(&line, &len, fp) != -1)
+    {
+        lineNumber++;
+        char *p = line;
+        while (isspace((unsigned char) *p))
+        {
+            p++;
+        }
+        if (*p == '\0' || *p == '#')
+        {
+            continue;
+        }
+
+        char *inputPath = strtok(p, " \t\r\n");
+        char *outputPath = strtok(NULL, " \t\r\n");
+        if (outputPath == NULL)
+        {
+            fprintf(stderr, "%s:%d: expected <INPUT_PATH> <OUTPUT_PATH>.\n", manifestPath, lineNumber);
+            continue;
+        }
+
+        if (*nJobs == capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            BatchJob *grown = realloc(*jobs, sizeof(BatchJob) * capacity);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "No memory for batch jobs.\n");
+                break;
+            }
+            *jobs = grown;
+        }
+
+        BatchJob *job = &(*jobs)[*nJobs];
+        job->inputPath = strdup(inputPath);
+        job->outputPath = strdup(outputPath);
+        if (job->inputPath == NULL || job->outputPath == NULL)
+        {
+            free(job->inputPath);
+            free(job->outputPath);
+            fprintf(stderr, "No memory for batch jobs.\n");
+            break;
+        }
+        job->nGenerations = 0;
+        job->nRows = 0;
+        job->nCols = 0;
+        job->cells = 0;
+        job->work = 0;
+
+        int nGenerations, nRows, nCols;
+        if (readInputHeader(inputPath, &nGenerations, &nRows, &nCols) == 0)
+        {
+            job->nGenerations = nGenerations;
+            job->nRows = nRows;
+            job->nCols = nCols;
+            job->cells = (long) nRows * nCols;
+            job->work = job->cells * nGenerations;
+        }
+        (*nJobs)++;
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Reads, simulates and writes out a single job in *ctx, creating the context if *ctx is NULL and resetting
+ * it otherwise. A context is only reused if the job runs with the same rules. Errors are reported against
+ * the job's input path. -1 is returned on error.
+ */
+static int runJob(const BatchJob *job, GoiContext **ctx, const GoiOptions *options, bool fixedRules)
+{
+    GoiInput input;
+    GoiOptions jobOptions;
+    if (readJobInput(job, &input, options, fixedRules, &jobOptions) == -1)
+    {
+        return -1;
+    }
+    int ret = runInput(job, &input, ctx, &jobOptions);
+    freeInput(&input);
+    return ret;
+}
+
+/**
+ * Simulates job from its already read input with jobOptions, reusing *ctx as runJob does, and writes its
+ * output. -1 is returned on error.
+ */
+static int runInput(const BatchJob *job, GoiInput *input, GoiContext **ctx, const GoiOptions *jobOptions)
+{
+    if (*ctx != NULL && memcmp(&goi_options(*ctx)->rules, &jobOptions->rules, sizeof(GoiRules)) != 0)
+    {
+        goi_destroy(*ctx);
+        *ctx = NULL;
+    }
+
+    int ret;
+    if (*ctx == NULL)
+    {
+        *ctx = goi_create(jobOptions, input->startWorld, input->nRows, input->nCols, input->nInvasions, input->invasionTimes, input->invasionPlans);
+        ret = *ctx == NULL ? -1 : 0;
+    }
+    else
+    {
+        ret = goi_reset(*ctx, input->startWorld, input->nRows, input->nCols, input->nInvasions, input->invasionTimes, input->invasionPlans);
+    }
+    if (ret == 0)
+    {
+        ret = goi_step(*ctx, input->nGenerations);
+    }
+    long warDeathToll = ret == 0 ? goi_death_toll(*ctx) : -1;
+    if (ret == -1)
+    {
+        // a context that failed to reset cannot be reused
+        goi_destroy(*ctx);
+        *ctx = NULL;
+        fprintf(stderr, "Failed to simulate %s.\n", job->inputPath);
+        return -1;
+    }
+
+    return writeJobOutput(job, warDeathToll);
+}
+
+/**
+ * Reads the input of job, and the options to simulate it with into jobOptions: options, with the input's own
+ * rules unless fixedRules is set. Errors are reported against the job's input path. -1 is returned on error.
+ */
+static int readJobInput(const BatchJob *job, GoiInput *input, const GoiOptions *options, bool fixedRules, GoiOptions *jobOptions)
+{
+    FILE *inputFile = fopen(job->inputPath, "r");
+    if (inputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for reading.\n", job->inputPath);
+        return -1;
+    }
+
+    PROFILE_START(PHASE_PARSE);
+    int ret = readInput(inputFile, input, options->engine == GOI_ENGINE_MAPPED);
+    fclose(inputFile);
+    PROFILE_END(PHASE_PARSE);
+    if (ret == -1)
+    {
+        fprintf(stderr, "Failed to parse %s.\n", job->inputPath);
+        return -1;
+    }
+
+    *jobOptions = *options;
+    if (!fixedRules)
+    {
+        applyInputRules(input, jobOptions);
+    }
+    return 0;
+}
+
+/**
+ * Writes the death toll of job to its output path. -1 is returned on error.
+ */
+static int writeJobOutput(const BatchJob *job, long warDeathToll)
+{
+    PROFILE_START(PHASE_OUTPUT);
+    FILE *outputFile = fopen(job->outputPath, "w");
+    if (outputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing.\n", job->outputPath);
+        return -1;
+    }
+    fprintf(outputFile, "%ld", warDeathToll);
+    fclose(outputFile);
+    PROFILE_END(PHASE_OUTPUT);
+    return 0;
+}
+
+/**
+ * Orders large jobs before small ones, and the most work first within each group.
+ */
+static int compareJobsByWork(const void *a, const void *b)
+{
+    int largeA = ((const BatchJob *) a)->cells >= BATCH_SMALL_JOB_CELLS;
+    int largeB = ((const BatchJob *) b)->cells >= BATCH_SMALL_JOB_CELLS;
+    if (largeA != largeB)
+    {
+        return largeB - largeA;
+    }
+
+    long workA = ((const BatchJob *) a)->work;
+    long workB = ((const BatchJob *) b)->work;
+    return (workA < workB) - (workA > workB);
+}
+
+/**
+ * Orders jobs by dimensions and then generations, so that jobs that can share an ensemble are adjacent.
+ */
+static int compareJobsByShape(const void *a, const void *b)
+{
+    const BatchJob *jobA = a;
+    const BatchJob *jobB = b;
+    if (jobA->nRows != jobB->nRows)
+    {
+        return (jobA->nRows > jobB->nRows) - (jobA->nRows < jobB->nRows);
+    }
+    if (jobA->nCols != jobB->nCols)
+    {
+        return (jobA->nCols > jobB->nCols) - (jobA->nCols < jobB->nCols);
+    }
+    return (jobA->nGenerations > jobB->nGenerations) - (jobA->nGenerations < jobB->nGenerations);
+}
+
+static void freeJobs(BatchJob *jobs, int nJobs)
+{
+    for (int i = 0; i < nJobs; i++)
+    {
+        free(jobs[i].inputPath);
+        free(jobs[i].outputPath);
+    }
+    free(jobs);
+}
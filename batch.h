@@ -0,0 +1,10 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "goi.h"
+
+int runBatch(const char *manifestPath, const GoiOptions *options, bool fixedRules);
+int runEnsembleBatch(const char *manifestPath, const GoiOptions *options, bool fixedRules);
+
+#endif
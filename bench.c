@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "input.h"
+#include "goi.h"
+#include "util.h"
+
+#define CSV_HEADER "input,rows,cols,generations,invasions,threads,repetitions,median_s,min_s,stddev_s,death_toll\n"
+
+static int compareDoubles(const void *a, const void *b);
+
+/**
+ * Benchmarks the input at inputPath once per thread count in options.
+ *
+ * The input is parsed once. Each thread count is then simulated nWarmups times untimed, followed by
+ * nRepetitions timed runs, all in one simulation context that is reset between runs. Only the simulation
+ * itself is timed, not the reset before it, using a monotonic wall clock. The median, minimum and standard
+ * deviation of the timed runs are printed, and appended as one CSV row per thread count to options->csvPath
+ * if it is set.
+ *
+ * -1 is returned on error.
+ */
+int runBenchmark(const char *inputPath, const BenchOptions *options)
+{
+    FILE *inputFile = fopen(inputPath, "r");
+    if (inputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for reading.\n", inputPath);
+        return -1;
+    }
+
+    GoiInput input;
+    int ret = readInput(inputFile, &input, options->simulation.engine == GOI_ENGINE_MAPPED);
+    fclose(inputFile);
+    if (ret == -1)
+    {
+        fprintf(stderr, "Failed to parse %s.\n", inputPath);
+        return -1;
+    }
+
+    FILE *csvFile = NULL;
+    if (options->csvPath != NULL)
+    {
+        csvFile = fopen(options->csvPath, "a");
+        if (csvFile == NULL)
+        {
+            fprintf(stderr, "Failed to open %s for appending.\n", options->csvPath);
+            freeInput(&input);
+            return -1;
+        }
+        // only a fresh file gets a header, so that many runs can append to one CSV
+        fseek(csvFile, 0, SEEK_END);
+        if (ftell(csvFile) == 0)
+        {
+            fputs(CSV_HEADER, csvFile);
+        }
+    }
+
+    double *times = malloc(sizeof(double) * options->nRepetitions);
+    if (times == NULL)
+    {
+        fprintf(stderr, "No memory for benchmark results.\n");
+        if (csvFile != NULL)
+        {
+            fclose(csvFile);
+        }
+        freeInput(&input);
+        return -1;
+    }
+
+    ret = 0;
+    for (int t = 0; t < options->nThreadCounts && ret == 0; t++)
+    {
+        GoiOptions goiOptions = options->simulation;
+        if (!options->fixedRules)
+        {
+            applyInputRules(&input, &goiOptions);
+        }
+        goiOptions.nThreads = options->threadCounts[t];
+        int nThreads = goiOptions.nThreads;
+        long warDeathToll = 0;
+
+        GoiContext *ctx = goi_create(&goiOptions, input.startWorld, input.nRows, input.nCols, input.nInvasions, input.invasionTimes, input.invasionPlans);
+        if (ctx == NULL)
+        {
+            fprintf(stderr, "Failed to simulate %s.\n", inputPath);
+            ret = -1;
+            break;
+        }
+
+        for (int i = 0; i < options->nWarmups + options->nRepetitions; i++)
+        {
+            if (goi_reset(ctx, input.startWorld, input.nRows, input.nCols, input.nInvasions, input.invasionTimes, input.invasionPlans) == -1)
+            {
+                fprintf(stderr, "Failed to simulate %s.\n", inputPath);
+                ret = -1;
+                break;
+            }
+            // the reset copies the world in and scans it, which is setup rather than simulation
+            double start = getWallTime();
+            if (goi_step(ctx, input.nGenerations) == -1)
+            {
+                fprintf(stderr, "Failed to simulate %s.\n", inputPath);
+                ret = -1;
+                break;
+            }
+            double end = getWallTime();
+            warDeathToll = goi_death_toll(ctx);
+            if (i >= options->nWarmups)
+            {
+                times[i - options->nWarmups] = end - start;
+            }
+        }
+        goi_destroy(ctx);
+        if (ret == -1)
+        {
+            break;
+        }
+
+        double mean = 0;
+        for (int i = 0; i < options->nRepetitions; i++)
+        {
+            mean += times[i];
+        }
+        mean /= options->nRepetitions;
+        double variance = 0;
+        for (int i = 0; i < options->nRepetitions; i++)
+        {
+            variance += (times[i] - mean) * (times[i] - mean);
+        }
+        double stddev = options->nRepetitions > 1 ? sqrt(variance / (options->nRepetitions - 1)) : 0;
+
+        qsort(times, options->nRepetitions, sizeof(double), compareDoubles);
+        int mid = options->nRepetitions / 2;
+        double median = options->nRepetitions % 2 == 1 ? times[mid] : (times[mid - 1] + times[mid]) / 2;
+        double min = times[0];
+
+        printf("%s with %d threads: median %f s, min %f s, stddev %f s over %d runs (death toll %ld)\n",
+               inputPath, nThreads, median, min, stddev, options->nRepetitions, warDeathToll);
+        if (csvFile != NULL)
+        {
+            fprintf(csvFile, "%s,%d,%d,%d,%d,%d,%d,%f,%f,%f,%ld\n", inputPath, input.nRows, input.nCols, input.nGenerations,
+                    input.nInvasions, nThreads, options->nRepetitions, median, min, stddev, warDeathToll);
+        }
+    }
+
+    free(times);
+    if (csvFile != NULL)
+    {
+        fclose(csvFile);
+    }
+    freeInput(&input);
+    return ret;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
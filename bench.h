@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include "goi.h"
+
+/**
+ * How a benchmark is run. Every thread count in threadCounts is measured separately, with simulation as the
+ * rest of the options. The input's own rules take precedence over simulation.rules unless fixedRules is set.
+ */
+typedef struct
+{
+    GoiOptions simulation;
+    bool fixedRules;
+    int nWarmups;
+    int nRepetitions;
+    int nThreadCounts;
+    const int *threadCounts;
+    const char *csvPath; // NULL to only print the summary
+} BenchOptions;
+
+int runBenchmark(const char *inputPath, const BenchOptions *options);
+
+#endif
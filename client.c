@@ -0,0 +1,218 @@
+/**
+ * Client for the resident daemon (goi-parallel.out --serve, see daemon.c). Submits one input to the daemon and
+ * writes its death toll to the output path, as goi-parallel.out would, without a simulator process of its own.
+ *
+ * An input path is resolved and sent for the daemon to open; "-" (or --inline) sends the input itself, for a
+ * daemon that cannot see the client's files or an input arriving on a pipe. The output path defaults to "-",
+ * stdout. With --stats, the time the simulation took and the final cells of each faction are written too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static void printUsage(const char *program);
+static int connectTo(const char *socketPath);
+static char *readWhole(FILE *fp, long *nBytes);
+
+int main(int argc, char *argv[])
+{
+    bool stats = false;
+    bool sendInline = false;
+    bool shutdown = false;
+
+    static const struct option longOptions[] = {
+        {"stats", no_argument, NULL, 's'},
+        {"inline", no_argument, NULL, 'i'},
+        {"shutdown", no_argument, NULL, 'q'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            stats = true;
+            break;
+        case 'i':
+            sendInline = true;
+            break;
+        case 'q':
+            shutdown = true;
+            break;
+        default:
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    char **args = argv + optind;
+    int nArgs = argc - optind;
+    if (nArgs < (shutdown ? 1 : 2))
+    {
+        printUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = connectTo(args[0]);
+    if (fd == -1)
+    {
+        exit(EXIT_FAILURE);
+    }
+    // requests and replies go through streams of their own, as one stream cannot switch between the two
+    int replyFd = dup(fd);
+    FILE *daemon = fdopen(fd, "w");
+    FILE *replies = replyFd == -1 ? NULL : fdopen(replyFd, "r");
+    if (daemon == NULL || replies == NULL)
+    {
+        fprintf(stderr, "Failed to talk to the daemon. Aborting...\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *statsFlag = stats ? "STATS " : "";
+    if (shutdown)
+    {
+        fprintf(daemon, "SHUTDOWN\n");
+    }
+    else if (sendInline || strcmp(args[1], "-") == 0)
+    {
+        FILE *inputFile = strcmp(args[1], "-") == 0 ? stdin : fopen(args[1], "r");
+        long nBytes;
+        char *payload = inputFile == NULL ? NULL : readWhole(inputFile, &nBytes);
+        if (payload == NULL)
+        {
+            fprintf(stderr, "Failed to read %s. Aborting...\n", args[1]);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(daemon, "INLINE %s%ld\n", statsFlag, nBytes);
+        fwrite(payload, 1, nBytes, daemon);
+        free(payload);
+    }
+    else
+    {
+        // the daemon opens the input itself, from its own working directory
+        char inputPath[PATH_MAX];
+        if (realpath(args[1], inputPath) == NULL)
+        {
+            fprintf(stderr, "Failed to find %s. Aborting...\n", args[1]);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(daemon, "RUN %s%s\n", statsFlag, inputPath);
+    }
+    fclose(daemon);
+
+    char *reply = NULL;
+    size_t len = 0;
+    if (getline(&reply, &len, replies) == -1)
+    {
+        fprintf(stderr, "The daemon hung up. Aborting...\n");
+        exit(EXIT_FAILURE);
+    }
+    fclose(replies);
+    reply[strcspn(reply, "\n")] = '\0';
+    if (strncmp(reply, "OK", 2) != 0)
+    {
+        fprintf(stderr, "The daemon failed: %s\n", reply);
+        exit(EXIT_FAILURE);
+    }
+    if (shutdown)
+    {
+        free(reply);
+        return 0;
+    }
+
+    // "OK <death toll>", and with --stats the seconds and the final cells of factions 0 to 9 after it
+    char *fields = reply + 2;
+    long warDeathToll = strtol(fields, &fields, 10);
+    const char *outputPath = nArgs >= 3 ? args[2] : "-";
+    bool writeStdout = strcmp(outputPath, "-") == 0;
+    FILE *outputFile = writeStdout ? stdout : fopen(outputPath, "w");
+    if (outputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing. Aborting...\n", outputPath);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(outputFile, "%ld", warDeathToll);
+    fclose(outputFile);
+    if (stats)
+    {
+        double seconds = strtod(fields, &fields);
+        FILE *status = writeStdout ? stderr : stdout;
+        fprintf(status, "Simulated in %f s; cells per faction:%s\n", seconds, fields);
+    }
+    free(reply);
+    return 0;
+}
+
+static void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--stats] [--inline] <SOCKET_PATH> <INPUT_PATH> [<OUTPUT_PATH>]\n", program);
+    fprintf(stderr, "       %s --shutdown <SOCKET_PATH>\n", program);
+    fprintf(stderr, "<INPUT_PATH> and <OUTPUT_PATH> may be -, for stdin and stdout (the default output).\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --stats     also write the time the simulation took and the final cells of each faction, 0 to 9\n");
+    fprintf(stderr, "  --inline    send the input itself rather than its path, for a daemon that cannot see it\n");
+    fprintf(stderr, "  --shutdown  stop the daemon\n");
+}
+
+// connectTo returns a socket connected to the daemon at socketPath, or -1 (with the reason written to
+// stderr) on error.
+static int connectTo(const char *socketPath)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "The socket path %s is too long.\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *) &address, sizeof(address)) == -1)
+    {
+        fprintf(stderr, "No daemon is serving on %s.\n", socketPath);
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// readWhole reads fp to its end into a new buffer and sets nBytes to its length. NULL is returned on error.
+static char *readWhole(FILE *fp, long *nBytes)
+{
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    while (buffer != NULL)
+    {
+        length += fread(buffer + length, 1, capacity - length, fp);
+        if (length < capacity)
+        {
+            break;
+        }
+        char *grown = realloc(buffer, capacity * 2);
+        if (grown == NULL)
+        {
+            free(buffer);
+            return NULL;
+        }
+        buffer = grown;
+        capacity *= 2;
+    }
+    if (buffer == NULL || ferror(fp) || length == 0)
+    {
+        free(buffer);
+        return NULL;
+    }
+    *nBytes = (long) length;
+    return buffer;
+}
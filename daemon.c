@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "daemon.h"
+#include "input.h"
+#include "goi.h"
+#include "population.h"
+
+/**
+ * A resident daemon that simulates inputs submitted over a Unix domain socket, so that a stream of short
+ * runs pays for process startup, the OpenMP runtime and faulting in world buffers once rather than per run.
+ * Its thread team stays up between jobs (OpenMP keeps its threads between parallel regions), and one
+ * simulation context is reset from job to job, which reuses its world buffers while the worlds fit in them.
+ *
+ * The protocol is line-based text. A client sends requests, each answered by one line, until it hangs up:
+ *     RUN [STATS] <path>       simulate the input file at path, as seen by the daemon
+ *     INLINE [STATS] <nBytes>  simulate the input in the nBytes bytes that follow the request line
+ *     SHUTDOWN                 stop serving once this request is answered
+ * A simulation is answered with "OK <death toll>", or with STATS "OK <death toll> <seconds> <live 0> ...
+ * <live 9>": the time the simulation took and the cells of each faction (the dead included) at its end. A
+ * failed request is answered with "ERROR <reason>".
+ *
+ * Connections are served one at a time, in the order they arrive, each job with the whole thread team. A
+ * connection that goes quiet for DAEMON_TIMEOUT_SECONDS, between requests or partway through a payload, is
+ * closed.
+ */
+
+#define DAEMON_BACKLOG 64
+
+// a client that sends nothing for this long is answered with "ERROR timed out" and hung up on, so that it
+// cannot hold up the clients queued behind it
+#define DAEMON_TIMEOUT_SECONDS 10
+
+typedef struct
+{
+    const GoiOptions *options;
+    bool fixedRules;
+    GoiContext *ctx; // kept from job to job; NULL until the first one
+    long nJobs;
+    bool stopping;
+} Daemon;
+
+static int listenOn(const char *socketPath);
+static void serveConnection(Daemon *daemon, int fd);
+static bool timedOut(FILE *in);
+static int serveRequest(Daemon *daemon, char *request, FILE *in, FILE *out);
+static void runJob(Daemon *daemon, FILE *source, const char *name, bool stats, FILE *out);
+
+/**
+ * Serves simulations on the Unix domain socket at socketPath until a client asks for a shutdown. Each job is
+ * simulated with options, except that the input's own rules take precedence unless fixedRules is set.
+ *
+ * A socket file left behind by a daemon that died is replaced. Returns -1 if the socket could not be set up,
+ * including when another daemon is serving on it.
+ */
+int runDaemon(const char *socketPath, const GoiOptions *options, bool fixedRules)
+{
+    int listenFd = listenOn(socketPath);
+    if (listenFd == -1)
+    {
+        return -1;
+    }
+    // a client that hangs up before its answer must not take the daemon down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    // start the thread team now rather than during the first job
+    #pragma omp parallel num_threads(options->nThreads > 0 ? options->nThreads : omp_get_max_threads())
+    {
+        #pragma omp single
+        printf("Serving on %s with %d threads\n", socketPath, omp_get_num_threads());
+    }
+    fflush(stdout);
+
+    Daemon daemon = {
+        .options = options,
+        .fixedRules = fixedRules,
+        .ctx = NULL,
+        .nJobs = 0,
+        .stopping = false,
+    };
+    int ret = 0;
+    while (!daemon.stopping)
+    {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            fprintf(stderr, "Failed to accept a connection on %s: %s.\n", socketPath, strerror(errno));
+            ret = -1;
+            break;
+        }
+        serveConnection(&daemon, fd);
+    }
+
+    printf("Served %ld jobs\n", daemon.nJobs);
+    goi_destroy(daemon.ctx);
+    close(listenFd);
+    unlink(socketPath);
+    return ret;
+}
+
+// listenOn returns a socket listening at socketPath, or -1 (with the reason written to stderr) on error.
+static int listenOn(const char *socketPath)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "The socket path %s is too long.\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    // a socket file that still answers belongs to a live daemon; one that does not is stale
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe != -1 && connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0)
+    {
+        fprintf(stderr, "A daemon is already serving on %s.\n", socketPath);
+        close(probe);
+        return -1;
+    }
+    if (probe != -1)
+    {
+        close(probe);
+    }
+    unlink(socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || bind(fd, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(fd, DAEMON_BACKLOG) == -1)
+    {
+        fprintf(stderr, "Failed to listen on %s: %s.\n", socketPath, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// serveConnection answers the requests on the connection fd until the client hangs up, then closes it.
+static void serveConnection(Daemon *daemon, int fd)
+{
+    struct timeval timeout = {.tv_sec = DAEMON_TIMEOUT_SECONDS};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // reading and writing go through streams of their own, as one stream cannot switch between the two
+    int outFd = dup(fd);
+    FILE *in = fdopen(fd, "r");
+    FILE *out = outFd == -1 ? NULL : fdopen(outFd, "w");
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "Failed to serve a connection: %s.\n", strerror(errno));
+        if (in != NULL)
+        {
+            fclose(in);
+        }
+        else
+        {
+            close(fd);
+        }
+        if (out != NULL)
+        {
+            fclose(out);
+        }
+        else if (outFd != -1)
+        {
+            close(outFd);
+        }
+        return;
+    }
+
+    char *request = NULL;
+    size_t len = 0;
+    while (!daemon->stopping)
+    {
+        if (getline(&request, &len, in) == -1)
+        {
+            if (timedOut(in))
+            {
+                fprintf(out, "ERROR timed out\n");
+            }
+            break;
+        }
+        request[strcspn(request, "\r\n")] = '\0';
+        int ret = serveRequest(daemon, request, in, out);
+        if (fflush(out) == EOF || ret == -1)
+        {
+            break;
+        }
+    }
+
+    free(request);
+    fclose(in);
+    fclose(out);
+}
+
+// timedOut returns whether the last read from in failed because the client went quiet for longer than
+// DAEMON_TIMEOUT_SECONDS.
+static bool timedOut(FILE *in)
+{
+    return ferror(in) && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+// serveRequest answers one request, whose line is request, on out. in is read past the request if it
+// carries a payload. -1 is returned if the connection cannot go on, as when a payload was cut short.
+static int serveRequest(Daemon *daemon, char *request, FILE *in, FILE *out)
+{
+    char *argument = request + strcspn(request, " ");
+    if (*argument != '\0')
+    {
+        *argument++ = '\0';
+    }
+    bool stats = strncmp(argument, "STATS ", 6) == 0;
+    if (stats)
+    {
+        argument += 6;
+    }
+
+    if (strcmp(request, "SHUTDOWN") == 0)
+    {
+        fprintf(out, "OK\n");
+        daemon->stopping = true;
+        return 0;
+    }
+
+    if (strcmp(request, "RUN") == 0)
+    {
+        FILE *source = fopen(argument, "r");
+        if (source == NULL)
+        {
+            fprintf(out, "ERROR cannot open %s\n", argument);
+            return 0;
+        }
+        runJob(daemon, source, argument, stats, out);
+        fclose(source);
+        return 0;
+    }
+
+    if (strcmp(request, "INLINE") == 0)
+    {
+        char *end;
+        long nBytes = strtol(argument, &end, 10);
+        if (end == argument || *end != '\0' || nBytes <= 0)
+        {
+            fprintf(out, "ERROR bad payload size %s\n", argument);
+            return -1;
+        }
+        char *payload = malloc(nBytes);
+        if (payload == NULL)
+        {
+            fprintf(out, "ERROR no memory for %ld bytes\n", nBytes);
+            return -1;
+        }
+        if (fread(payload, 1, nBytes, in) != (size_t) nBytes)
+        {
+            fprintf(out, timedOut(in) ? "ERROR timed out\n" : "ERROR payload cut short\n");
+            free(payload);
+            return -1;
+        }
+        FILE *source = fmemopen(payload, nBytes, "r");
+        if (source == NULL)
+        {
+            fprintf(out, "ERROR cannot read the payload\n");
+        }
+        else
+        {
+            runJob(daemon, source, "inline input", stats, out);
+            fclose(source);
+        }
+        free(payload);
+        return 0;
+    }
+
+    fprintf(out, "ERROR unknown request %s\n", request);
+    return 0;
+}
+
+// runJob simulates the input read from source, whose name is for messages, and answers on out.
+static void runJob(Daemon *daemon, FILE *source, const char *name, bool stats, FILE *out)
+{
+    GoiInput input;
+    if (readInput(source, &input, daemon->options->engine == GOI_ENGINE_MAPPED) == -1)
+    {
+        fprintf(out, "ERROR cannot parse %s\n", name);
+        return;
+    }
+    GoiOptions jobOptions = *daemon->options;
+    if (!daemon->fixedRules)
+    {
+        applyInputRules(&input, &jobOptions);
+    }
+
+    // the context is reset from job to job, so that its buffers are reused, until the rules change
+    if (daemon->ctx != NULL && memcmp(&goi_options(daemon->ctx)->rules, &jobOptions.rules, sizeof(GoiRules)) != 0)
+    {
+        goi_destroy(daemon->ctx);
+        daemon->ctx = NULL;
+    }
+    double start = omp_get_wtime();
+    int ret;
+    if (daemon->ctx == NULL)
+    {
+        daemon->ctx = goi_create(&jobOptions, input.startWorld, input.nRows, input.nCols, input.nInvasions, input.invasionTimes, input.invasionPlans);
+        ret = daemon->ctx == NULL ? -1 : 0;
+    }
+    else
+    {
+        ret = goi_reset(daemon->ctx, input.startWorld, input.nRows, input.nCols, input.nInvasions, input.invasionTimes, input.invasionPlans);
+    }
+    if (ret == 0)
+    {
+        ret = goi_step(daemon->ctx, input.nGenerations);
+    }
+    if (ret == -1)
+    {
+        // a context that failed to reset cannot be reused
+        goi_destroy(daemon->ctx);
+        daemon->ctx = NULL;
+        fprintf(out, "ERROR cannot simulate %s\n", name);
+        freeInput(&input);
+        return;
+    }
+    double seconds = omp_get_wtime() - start;
+
+    long warDeathToll = goi_death_toll(daemon->ctx);
+    fprintf(out, "OK %ld", warDeathToll);
+    const int *world;
+    if (stats && (world = goi_world(daemon->ctx)) != NULL)
+    {
+        GoiPopulationStats population;
+        countPopulation(world, (long) goi_rows(daemon->ctx) * goi_cols(daemon->ctx), &population);
+        fprintf(out, " %f", seconds);
+        for (int faction = 0; faction < GOI_MAX_FACTIONS; faction++)
+        {
+            fprintf(out, " %ld", population.live[faction]);
+        }
+    }
+    fprintf(out, "\n");
+
+    daemon->nJobs++;
+    printf("Job %ld: %s, death toll %ld in %f s\n", daemon->nJobs, name, warDeathToll, seconds);
+    fflush(stdout);
+    freeInput(&input);
+}
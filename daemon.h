@@ -0,0 +1,9 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdbool.h>
+#include "goi.h"
+
+int runDaemon(const char *socketPath, const GoiOptions *options, bool fixedRules);
+
+#endif
@@ -0,0 +1,424 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "goi.h"
+#include "rules.h"
+#include "profile.h"
+#include <omp.h>
+
+/**
+ * The ensemble engine. Cell (row, col) of every world is stored side by side as one vector of 8-bit lanes,
+ * world k in lane k, so each step of the kernel below advances that cell in all worlds at once. The rules are
+ * applied with lane-wise comparisons rather than table lookups, which vector units cannot do. Worlds beyond
+ * nWorlds are left dead.
+ *
+ * The layout is otherwise that of the dense engine: a one-cell halo all around, dead or (for a torus)
+ * refreshed from the opposite edges before every generation.
+ */
+
+#define ENSEMBLE_LANES GOI_ENSEMBLE_MAX_WORLDS
+
+typedef uint8_t Lanes __attribute__((vector_size(ENSEMBLE_LANES)));
+
+// the kernel works on vectors the target has registers for; GCC splits wider ones into single bytes
+#ifdef __AVX2__
+#define PART_LANES 32
+#else
+#define PART_LANES 16
+#endif
+#define PARTS (ENSEMBLE_LANES / PART_LANES)
+
+typedef uint8_t Part __attribute__((vector_size(PART_LANES)));
+
+// per-lane fight counters are 8-bit, so they are emptied into the totals at least this often
+#define FLUSH_INTERVAL 255
+
+struct GoiEnsemble
+{
+    GoiOptions options;
+    int nWorlds;
+    int nRows;
+    int nCols;
+    int stride;
+
+    // padded (nRows + 2) x stride cells, as in the dense engine
+    Lanes *world;
+    Lanes *nextWorld;
+    Lanes *invaders;
+
+    // the rules, as lists of the counts that satisfy them
+    int nFactions;
+    uint8_t factions[MAX_FACTIONS - 1]; // every faction alive in some world or plan, in ascending order
+    int nBirthCounts;
+    uint8_t birthCounts[MAX_NEIGHBORS + 1];
+    int nSurvivalCounts;
+    uint8_t survivalCounts[MAX_NEIGHBORS + 1];
+    uint8_t fightThreshold;
+
+    // borrowed, per world
+    int nInvasions[ENSEMBLE_LANES];
+    const int *invasionTimes[ENSEMBLE_LANES];
+    int **invasionPlans[ENSEMBLE_LANES];
+    int invasionIndex[ENSEMBLE_LANES];
+
+    int generation;
+    long deathTolls[ENSEMBLE_LANES];
+};
+
+static Lanes *allocLanes(long nCells);
+static void nextLanesRow(const GoiEnsemble *ensemble, const Lanes *above, const Lanes *row, const Lanes *below,
+                         const Lanes *invaders, Lanes *next, int nCols, long *deaths);
+static void landInvaders(GoiEnsemble *ensemble, bool *invading);
+static void refreshLanesHalo(GoiEnsemble *ensemble);
+
+/**
+ * Creates an ensemble of nWorlds (1 to GOI_ENSEMBLE_MAX_WORLDS) nRows x nCols worlds, all positioned at
+ * generation 0. World k starts from startWorlds[k] and has nInvasions[k] invasions at invasionTimes[k] with
+ * plans invasionPlans[k], borrowed under the same rules as for goi_create. options may be NULL for the
+ * defaults; its engine is ignored and its topology must be bounded or toroidal.
+ *
+ * Returns NULL if the arguments are invalid, a cell is not a faction in [0, 9], or out of memory.
+ */
+GoiEnsemble *goi_ensemble_create(const GoiOptions *options, int nWorlds, int nRows, int nCols, int *const *startWorlds,
+                                 const int *nInvasions, int *const *invasionTimes, int **const *invasionPlans)
+{
+    if (nWorlds < 1 || nWorlds > ENSEMBLE_LANES || nRows <= 0 || nCols <= 0)
+    {
+        return NULL;
+    }
+    GoiEnsemble *ensemble = calloc(1, sizeof(GoiEnsemble));
+    if (ensemble == NULL)
+    {
+        return NULL;
+    }
+
+    if (options != NULL)
+    {
+        ensemble->options = *options;
+    }
+    else
+    {
+        goi_default_options(&ensemble->options);
+    }
+    if (ensemble->options.nThreads <= 0)
+    {
+        ensemble->options.nThreads = omp_get_max_threads();
+    }
+    if (ensemble->options.topology != GOI_TOPOLOGY_BOUNDED && ensemble->options.topology != GOI_TOPOLOGY_TOROIDAL)
+    {
+        goi_ensemble_destroy(ensemble);
+        return NULL;
+    }
+
+    ensemble->nWorlds = nWorlds;
+    ensemble->nRows = nRows;
+    ensemble->nCols = nCols;
+    ensemble->stride = nCols + 2;
+    long nCells = (long) (nRows + 2) * ensemble->stride;
+    ensemble->world = allocLanes(nCells);
+    ensemble->nextWorld = allocLanes(nCells);
+    ensemble->invaders = allocLanes(nCells);
+    if (ensemble->world == NULL || ensemble->nextWorld == NULL || ensemble->invaders == NULL)
+    {
+        goi_ensemble_destroy(ensemble);
+        return NULL;
+    }
+
+    // interleave the worlds, noting which factions occur anywhere
+    unsigned present = 0;
+    for (int k = 0; k < nWorlds; k++)
+    {
+        for (int row = 0; row < nRows; row++)
+        {
+            Lanes *cells = ensemble->world + (long) (row + 1) * ensemble->stride + 1;
+            const int *source = startWorlds[k] + (long) row * nCols;
+            for (int col = 0; col < nCols; col++)
+            {
+                unsigned cell = source[col];
+                present |= 1u << (cell < MAX_FACTIONS ? cell : 31);
+                cells[col][k] = cell;
+            }
+        }
+
+        ensemble->nInvasions[k] = nInvasions[k];
+        ensemble->invasionTimes[k] = invasionTimes[k];
+        ensemble->invasionPlans[k] = invasionPlans[k];
+        for (int i = 0; i < nInvasions[k]; i++)
+        {
+            for (long cell = 0; cell < (long) nRows * nCols; cell++)
+            {
+                unsigned invader = invasionPlans[k][i][cell];
+                present |= 1u << (invader < MAX_FACTIONS ? invader : 31);
+            }
+        }
+    }
+    if (present & ~((1u << MAX_FACTIONS) - 1))
+    {
+        goi_ensemble_destroy(ensemble);
+        return NULL;
+    }
+
+    const GoiRules *rules = &ensemble->options.rules;
+    for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    {
+        if (present & (1u << faction))
+        {
+            ensemble->factions[ensemble->nFactions++] = faction;
+        }
+    }
+    for (int count = 0; count <= MAX_NEIGHBORS; count++)
+    {
+        if (rules->birthMask & (1u << count))
+        {
+            ensemble->birthCounts[ensemble->nBirthCounts++] = count;
+        }
+        if (rules->survivalMask & (1u << count))
+        {
+            ensemble->survivalCounts[ensemble->nSurvivalCounts++] = count;
+        }
+    }
+    // a threshold above the most neighbours a cell can have never triggers
+    ensemble->fightThreshold = rules->fightThreshold <= MAX_NEIGHBORS ? rules->fightThreshold : MAX_NEIGHBORS + 1;
+    return ensemble;
+}
+
+void goi_ensemble_destroy(GoiEnsemble *ensemble)
+{
+    if (ensemble == NULL)
+    {
+        return;
+    }
+    free(ensemble->world);
+    free(ensemble->nextWorld);
+    free(ensemble->invaders);
+    free(ensemble);
+}
+
+/**
+ * Advances every world of the ensemble by nGenerations generations. Returns 0, or -1 if nGenerations is
+ * negative.
+ */
+int goi_ensemble_step(GoiEnsemble *ensemble, int nGenerations)
+{
+    if (nGenerations < 0)
+    {
+        return -1;
+    }
+
+    int nRows = ensemble->nRows;
+    int nCols = ensemble->nCols;
+    long stride = ensemble->stride;
+    int lastGeneration = ensemble->generation + nGenerations;
+    for (int i = ensemble->generation + 1; i <= lastGeneration; i++)
+    {
+        ensemble->generation = i;
+        if (ensemble->options.topology == GOI_TOPOLOGY_TOROIDAL)
+        {
+            PROFILE_START(PHASE_HALO);
+            refreshLanesHalo(ensemble);
+            PROFILE_END(PHASE_HALO);
+        }
+
+        // each world invades on its own schedule
+        bool invading[ENSEMBLE_LANES] = {false};
+        bool anyInvading = false;
+        for (int k = 0; k < ensemble->nWorlds; k++)
+        {
+            int index = ensemble->invasionIndex[k];
+            invading[k] = index < ensemble->nInvasions[k] && i == ensemble->invasionTimes[k][index];
+            anyInvading |= invading[k];
+        }
+        const Lanes *inv = NULL;
+        if (anyInvading)
+        {
+            PROFILE_START(PHASE_INVASION_COPY);
+            landInvaders(ensemble, invading);
+            inv = ensemble->invaders;
+            PROFILE_END(PHASE_INVASION_COPY);
+        }
+
+        const Lanes *world = ensemble->world;
+        Lanes *wholeNewWorld = ensemble->nextWorld;
+        long deaths[ENSEMBLE_LANES] = {0};
+        PROFILE_START(PHASE_KERNEL);
+        #pragma omp parallel num_threads(ensemble->options.nThreads) reduction(+:deaths[:ENSEMBLE_LANES])
+        {
+            PROFILE_THREAD_START();
+            #pragma omp for nowait
+            for (long row = 1; row <= nRows; row++)
+            {
+                long offset = row * stride + 1;
+                nextLanesRow(ensemble, world + offset - stride, world + offset, world + offset + stride,
+                             inv != NULL ? inv + offset : NULL, wholeNewWorld + offset, nCols, deaths);
+            }
+            PROFILE_THREAD_END();
+        }
+        PROFILE_END(PHASE_KERNEL);
+
+        for (int k = 0; k < ensemble->nWorlds; k++)
+        {
+            ensemble->deathTolls[k] += deaths[k];
+        }
+        ensemble->nextWorld = ensemble->world;
+        ensemble->world = wholeNewWorld;
+    }
+    return 0;
+}
+
+int goi_ensemble_size(const GoiEnsemble *ensemble)
+{
+    return ensemble->nWorlds;
+}
+
+/**
+ * Returns the number of deaths due to fighting so far in world (0 to goi_ensemble_size - 1).
+ */
+long goi_ensemble_death_toll(const GoiEnsemble *ensemble, int world)
+{
+    return ensemble->deathTolls[world];
+}
+
+// allocLanes returns zeroed room for nCells cells of every lane, aligned for vector loads, or NULL.
+static Lanes *allocLanes(long nCells)
+{
+    Lanes *cells = aligned_alloc(sizeof(Lanes), sizeof(Lanes) * nCells);
+    if (cells != NULL)
+    {
+        memset(cells, 0, sizeof(Lanes) * nCells);
+    }
+    return cells;
+}
+
+/**
+ * The ensemble counterpart of the dense row kernels: computes the next state of one row of nCols cells, in
+ * every lane, into next. Fighting deaths are added per lane to deaths.
+ */
+static void nextLanesRow(const GoiEnsemble *ensemble, const Lanes *above, const Lanes *row, const Lanes *below,
+                         const Lanes *invaders, Lanes *next, int nCols, long *deaths)
+{
+    bool override = ensemble->options.rules.invasionPolicy == GOI_INVASION_OVERRIDE;
+    // parts holding no world stay dead and are skipped
+    int nParts = (ensemble->nWorlds + PART_LANES - 1) / PART_LANES;
+    for (int part = 0; part < nParts; part++)
+    {
+        // the same part of every cell, PARTS vectors apart
+        const Part *a = (const Part *) above + part;
+        const Part *r = (const Part *) row + part;
+        const Part *b = (const Part *) below + part;
+        const Part *inv = invaders != NULL ? (const Part *) invaders + part : NULL;
+        Part *out = (Part *) next + part;
+        long *partDeaths = deaths + part * PART_LANES;
+
+        Part fought = {0};
+        for (int col = 0; col < nCols; col++)
+        {
+            long at = (long) col * PARTS;
+            Part own = r[at];
+            Part n0 = a[at - PARTS], n1 = a[at], n2 = a[at + PARTS];
+            Part n3 = r[at - PARTS], n4 = r[at + PARTS];
+            Part n5 = b[at - PARTS], n6 = b[at], n7 = b[at + PARTS];
+
+            // comparisons give all-ones (-1) in every lane where they hold, so subtracting them counts
+            Part isLive = (Part) (own != DEAD_FACTION);
+            Part live = -(Part) (n0 != DEAD_FACTION) - (Part) (n1 != DEAD_FACTION) - (Part) (n2 != DEAD_FACTION)
+                        - (Part) (n3 != DEAD_FACTION) - (Part) (n4 != DEAD_FACTION) - (Part) (n5 != DEAD_FACTION)
+                        - (Part) (n6 != DEAD_FACTION) - (Part) (n7 != DEAD_FACTION);
+
+            // count each faction in turn; the last, highest, birthable faction wins a dead cell
+            Part friendly = {0};
+            Part born = {0};
+            for (int i = 0; i < ensemble->nFactions; i++)
+            {
+                uint8_t faction = ensemble->factions[i];
+                Part count = -(Part) (n0 == faction) - (Part) (n1 == faction) - (Part) (n2 == faction)
+                             - (Part) (n3 == faction) - (Part) (n4 == faction) - (Part) (n5 == faction)
+                             - (Part) (n6 == faction) - (Part) (n7 == faction);
+                friendly |= count & (Part) (own == faction);
+
+                Part birthable = {0};
+                for (int c = 0; c < ensemble->nBirthCounts; c++)
+                {
+                    birthable |= (Part) (count == ensemble->birthCounts[c]);
+                }
+                born = (born & ~birthable) | (birthable & faction);
+            }
+
+            Part survives = {0};
+            for (int c = 0; c < ensemble->nSurvivalCounts; c++)
+            {
+                survives |= (Part) (friendly == ensemble->survivalCounts[c]);
+            }
+            Part fights = isLive & (Part) (live - friendly >= ensemble->fightThreshold);
+            Part nextState = (own & survives & ~fights) | (born & ~isLive);
+
+            // did someone just get landed on? the value is overriden by the invasion at this position
+            if (inv != NULL)
+            {
+                Part lands = (Part) (inv[at] != DEAD_FACTION) & (override ? ~(Part) {0} : ~isLive);
+                fights = (fights & ~lands) | (lands & isLive);
+                nextState = (nextState & ~lands) | (inv[at] & lands);
+            }
+
+            out[at] = nextState;
+            fought -= fights;
+            if ((col + 1) % FLUSH_INTERVAL == 0 || col == nCols - 1)
+            {
+                for (int k = 0; k < PART_LANES; k++)
+                {
+                    partDeaths[k] += fought[k];
+                }
+                fought = (Part) {0};
+            }
+        }
+    }
+}
+
+// landInvaders fills the invader lanes of the worlds invading this generation from their plans, and clears
+// the rest, advancing the invading worlds to their next invasion.
+static void landInvaders(GoiEnsemble *ensemble, bool *invading)
+{
+    int nRows = ensemble->nRows;
+    int nCols = ensemble->nCols;
+    long stride = ensemble->stride;
+    const int *plans[ENSEMBLE_LANES];
+    for (int k = 0; k < ENSEMBLE_LANES; k++)
+    {
+        plans[k] = invading[k] ? ensemble->invasionPlans[k][ensemble->invasionIndex[k]++] : NULL;
+    }
+
+    #pragma omp parallel for num_threads(ensemble->options.nThreads)
+    for (int row = 0; row < nRows; row++)
+    {
+        Lanes *cells = ensemble->invaders + (row + 1) * stride + 1;
+        memset(cells, 0, sizeof(Lanes) * nCols);
+        for (int k = 0; k < ENSEMBLE_LANES; k++)
+        {
+            if (plans[k] != NULL)
+            {
+                const int *source = plans[k] + (long) row * nCols;
+                for (int col = 0; col < nCols; col++)
+                {
+                    cells[col][k] = source[col];
+                }
+            }
+        }
+    }
+}
+
+// refreshLanesHalo copies the opposite edges of the current world into its halo, as for a dense torus.
+static void refreshLanesHalo(GoiEnsemble *ensemble)
+{
+    Lanes *world = ensemble->world;
+    int nRows = ensemble->nRows;
+    int nCols = ensemble->nCols;
+    long stride = ensemble->stride;
+    for (int row = 1; row <= nRows; row++)
+    {
+        Lanes *cells = world + row * stride;
+        cells[0] = cells[nCols];
+        cells[nCols + 1] = cells[1];
+    }
+    memcpy(world, world + nRows * stride, sizeof(Lanes) * stride);
+    memcpy(world + (nRows + 1) * stride, world + stride, sizeof(Lanes) * stride);
+}
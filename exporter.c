@@ -9,13 +9,54 @@
  */
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
 #include "exporter.h"
-#include "sb/sb.h"
+#include "goi.h"
 #include "util.h"
 
 #define JSON_KEY "\"world\""
 
+/**
+ * The binary frame format, an alternative to the JSON frames that is compact and quick to read.
+ *
+ * A frame file starts with a 32-byte header: the magic "GOIF", then the format version (1), the number of
+ * factions (GOI_MAX_FACTIONS), the bits per cell (4) and the rows and columns of the world as 32-bit
+ * integers, then the size of every frame in bytes as a 64-bit integer. Each frame is then the generation and
+ * the death toll up to it as 64-bit integers, followed by the cells in row-major order, two to a byte, the
+ * first of each pair in the low 4 bits, and zero padding up to a multiple of 8 bytes. Integers are in the
+ * host's byte order.
+ *
+ * Frames are all the same size and 8-byte aligned, so frame k starts at byte 32 + k * frameBytes: a reader
+ * can map the file and jump to any generation.
+ */
+#define FRAME_MAGIC "GOIF"
+#define FRAME_VERSION 1
+#define FRAME_CELL_BITS 4
+#define FRAME_HEADER_BYTES 32
+#define FRAME_STATS_BYTES 16
+
+/**
+ * Frames with fewer cells than this are formatted on the calling thread alone, as handing them out costs more
+ * than it saves.
+ */
+#define PARALLEL_EXPORT_CELLS (256 * 256)
+
+// the longest a cell can be once formatted: an int and the comma after it
+#define MAX_CELL_CHARS 12
+
 FILE *exportFile = NULL;
+static int exportThreads = 0;
+static bool exportBinary = false;
+static int exportRows;
+static int exportCols;
+
+static int writeJsonFrame(FILE *file, const int *world, int nRows, int nCols);
+static char *formatRows(const int *world, int nRows, int nCols, int firstRow, int lastRow, char *out);
+static size_t frameBytes(int nRows, int nCols);
+static int partThreads(int nRows, int nCols);
 
 /**
  * Initializes the world exporter with the input file.
@@ -27,6 +68,44 @@ FILE *exportFile = NULL;
  */
 void initWorldExporter(FILE *file) {
     exportFile = file;
+    exportBinary = false;
+}
+
+/**
+ * Initializes the world exporter with the input file, as initWorldExporter does, but for binary frames of
+ * nRows x nCols worlds, whose header it writes. Frames are then written with exportFrame.
+ *
+ * -1 is returned, and nothing will be exported, if the header could not be written.
+ */
+int initBinaryWorldExporter(FILE *file, int nRows, int nCols)
+{
+    exportFile = NULL;
+    if (file == NULL)
+    {
+        return -1;
+    }
+    uint32_t header[FRAME_HEADER_BYTES / sizeof(uint32_t)] = {0, FRAME_VERSION, GOI_MAX_FACTIONS, FRAME_CELL_BITS, nRows, nCols};
+    uint64_t bytes = frameBytes(nRows, nCols);
+    memcpy(header, FRAME_MAGIC, sizeof(header[0]));
+    memcpy(header + 6, &bytes, sizeof(bytes));
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+    {
+        fprintf(stderr, "Error: cannot export to file.\n");
+        return -1;
+    }
+    exportFile = file;
+    exportBinary = true;
+    exportRows = nRows;
+    exportCols = nCols;
+    return 0;
+}
+
+/**
+ * Sets the number of threads that large frames are formatted with; 0 or less means OpenMP's default.
+ */
+void setWorldExporterThreads(int nThreads)
+{
+    exportThreads = nThreads;
 }
 
 /**
@@ -40,50 +119,216 @@ void exportWorld(const int *world, int nRows, int nCols)
     {
         return;
     }
+    writeJsonFrame(exportFile, world, nRows, nCols);
+}
+
+/**
+ * Exports the input world as the frame of generation, with the death toll up to it: a binary frame if the
+ * exporter was initialized with initBinaryWorldExporter, and otherwise as exportWorld does.
+ */
+void exportFrame(const int *world, int nRows, int nCols, int generation, long deathToll)
+{
+    if (exportFile == NULL)
+    {
+        return;
+    }
+    if (!exportBinary)
+    {
+        writeJsonFrame(exportFile, world, nRows, nCols);
+        return;
+    }
+    if (nRows != exportRows || nCols != exportCols)
+    {
+        fprintf(stderr, "Error: cannot export a %d x %d world among %d x %d frames.\n", nRows, nCols, exportRows, exportCols);
+        return;
+    }
 
-    StringBuilder *sb = sb_create();
-    if (sb == NULL)
+    size_t nBytes = frameBytes(nRows, nCols);
+    uint8_t *frame = malloc(nBytes);
+    if (frame == NULL)
     {
         fprintf(stderr, "Error: out of memory!\n");
         return;
     }
+    int64_t stats[2] = {generation, deathToll};
+    memcpy(frame, stats, sizeof(stats));
 
-    sb_append(sb, "{");
-    sb_append(sb, JSON_KEY);
-    sb_append(sb, ":[");
-    for (int row = 0; row < nRows; row++)
+    // pairs of cells into bytes, the padding included, with a last odd cell paired with a dead one
+    uint8_t *cells = frame + FRAME_STATS_BYTES;
+    long nCells = (long) nRows * nCols;
+    long nPaddedBytes = (long) (nBytes - FRAME_STATS_BYTES);
+    #pragma omp parallel for num_threads(partThreads(nRows, nCols)) schedule(static)
+    for (long i = 0; i < nPaddedBytes; i++)
     {
-        sb_append(sb, "[");
-        for (int col = 0; col < nCols; col++)
+        int low = 2 * i < nCells ? world[2 * i] : 0;
+        int high = 2 * i + 1 < nCells ? world[2 * i + 1] : 0;
+        cells[i] = (uint8_t) (low | high << FRAME_CELL_BITS);
+    }
+
+    if (fwrite(frame, nBytes, 1, exportFile) != 1)
+    {
+        fprintf(stderr, "Error: cannot export to file.\n");
+    }
+    free(frame);
+}
+
+/**
+ * Converts the binary frames read from in into the JSON frames that exportWorld writes, one per line, to out.
+ *
+ * -1 is returned, and the reason written to stderr, if in is not a frame file or is cut short, or out could
+ * not be written.
+ */
+int convertFramesToJson(FILE *in, FILE *out)
+{
+    uint32_t header[FRAME_HEADER_BYTES / sizeof(uint32_t)];
+    if (fread(header, sizeof(header), 1, in) != 1 || memcmp(header, FRAME_MAGIC, sizeof(header[0])) != 0)
+    {
+        fprintf(stderr, "Error: not a frame file.\n");
+        return -1;
+    }
+    uint64_t bytes;
+    memcpy(&bytes, header + 6, sizeof(bytes));
+    int nRows = (int) header[4];
+    int nCols = (int) header[5];
+    if (header[1] != FRAME_VERSION || header[3] != FRAME_CELL_BITS || nRows <= 0 || nCols <= 0 || bytes != frameBytes(nRows, nCols))
+    {
+        fprintf(stderr, "Error: unsupported frame file (version %u).\n", header[1]);
+        return -1;
+    }
+
+    long nCells = (long) nRows * nCols;
+    uint8_t *frame = malloc(bytes);
+    int *world = malloc(sizeof(int) * nCells);
+    int ret = frame == NULL || world == NULL ? -1 : 0;
+    if (ret == -1)
+    {
+        fprintf(stderr, "Error: out of memory!\n");
+    }
+    size_t nRead;
+    while (ret == 0 && (nRead = fread(frame, 1, bytes, in)) == bytes)
+    {
+        const uint8_t *cells = frame + FRAME_STATS_BYTES;
+        #pragma omp parallel for num_threads(partThreads(nRows, nCols)) schedule(static)
+        for (long i = 0; i < nCells; i++)
         {
-            sb_appendf(sb, "%d", getValueAt(world, nRows, nCols, row, col));
-            if (col != nCols - 1) {
-                sb_append(sb, ",");
+            world[i] = (cells[i / 2] >> (FRAME_CELL_BITS * (i % 2))) & ((1 << FRAME_CELL_BITS) - 1);
+        }
+        ret = writeJsonFrame(out, world, nRows, nCols);
+    }
+    if (ret == 0 && (ferror(in) || nRead != 0))
+    {
+        fprintf(stderr, "Error: the frame file is cut short.\n");
+        ret = -1;
+    }
+
+    free(frame);
+    free(world);
+    return ret;
+}
+
+// writeJsonFrame writes world to file as one JSON frame. The frame is formatted by row ranges, one per
+// thread, each into a buffer of its own, and the buffers are then written out in order, so the output is the
+// same whatever the number of threads. -1 is returned, and the reason written to stderr, on error.
+static int writeJsonFrame(FILE *file, const int *world, int nRows, int nCols)
+{
+    int nThreads = partThreads(nRows, nCols);
+    char **parts = calloc(nThreads, sizeof(char *));
+    size_t *partLengths = calloc(nThreads, sizeof(size_t));
+    bool failed = parts == NULL || partLengths == NULL;
+
+    if (!failed)
+    {
+        #pragma omp parallel for num_threads(nThreads) schedule(static, 1) reduction(||:failed)
+        for (int part = 0; part < nThreads; part++)
+        {
+            int firstRow = (int) ((long) nRows * part / nThreads);
+            int lastRow = (int) ((long) nRows * (part + 1) / nThreads);
+            // every row is its brackets and its comma, around its cells
+            parts[part] = malloc((size_t) (lastRow - firstRow) * ((size_t) nCols * MAX_CELL_CHARS + 3));
+            if (parts[part] == NULL)
+            {
+                failed = true;
+                continue;
             }
+            partLengths[part] = formatRows(world, nRows, nCols, firstRow, lastRow, parts[part]) - parts[part];
+        }
+    }
+    int ret = 0;
+    if (failed)
+    {
+        fprintf(stderr, "Error: out of memory!\n");
+        ret = -1;
+    }
+    else
+    {
+        bool written = fputs("{" JSON_KEY ":[", file) != EOF;
+        for (int part = 0; part < nThreads && written; part++)
+        {
+            written = fwrite(parts[part], 1, partLengths[part], file) == partLengths[part];
         }
-        sb_append(sb, "]");
-        if (row != nRows - 1) {
-            sb_append(sb, ",");
+        if (!written || fputs("]}\n", file) == EOF)
+        {
+            fprintf(stderr, "Error: cannot export to file.\n");
+            ret = -1;
         }
     }
-    sb_append(sb, "]}\n");
 
-    char *s = sb_concat(sb);
-    if (s == NULL)
+    for (int part = 0; parts != NULL && part < nThreads; part++)
     {
-        fprintf(stderr, "Error: out of memory!\n");
-        sb_free(sb);
-        return;
+        free(parts[part]);
     }
+    free(parts);
+    free(partLengths);
+    return ret;
+}
 
-    if (fputs(s, exportFile) == EOF)
+// formatRows writes rows firstRow to lastRow (exclusive) of world as JSON arrays into out, each followed by
+// a comma but the last row of the world, and returns the end of what it wrote.
+static char *formatRows(const int *world, int nRows, int nCols, int firstRow, int lastRow, char *out)
+{
+    for (int row = firstRow; row < lastRow; row++)
     {
-        fprintf(stderr, "Error: cannot export to file.\n");
-        free(s);
-        sb_free(sb);
-        return;
+        *out++ = '[';
+        for (int col = 0; col < nCols; col++)
+        {
+            int cell = getValueAt(world, nRows, nCols, row, col);
+            if (cell >= 0 && cell <= 9)
+            {
+                *out++ = (char) ('0' + cell);
+            }
+            else
+            {
+                out += sprintf(out, "%d", cell);
+            }
+            if (col != nCols - 1)
+            {
+                *out++ = ',';
+            }
+        }
+        *out++ = ']';
+        if (row != nRows - 1)
+        {
+            *out++ = ',';
+        }
     }
+    return out;
+}
+
+// frameBytes returns the size of a binary frame of an nRows x nCols world: its stats, then its cells two to a
+// byte, padded to a multiple of 8 bytes.
+static size_t frameBytes(int nRows, int nCols)
+{
+    size_t cellBytes = ((size_t) nRows * nCols + 1) / 2;
+    return FRAME_STATS_BYTES + (cellBytes + 7) / 8 * 8;
+}
 
-    free(s);
-    sb_free(sb);
-}
\ No newline at end of file
+// partThreads returns the number of threads to export an nRows x nCols frame with, at most one per row.
+static int partThreads(int nRows, int nCols)
+{
+    if ((long) nRows * nCols < PARALLEL_EXPORT_CELLS)
+    {
+        return 1;
+    }
+    int nThreads = exportThreads > 0 ? exportThreads : omp_get_max_threads();
+    return nThreads < nRows ? nThreads : nRows;
+}
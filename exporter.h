@@ -4,6 +4,10 @@
 #include <stdio.h>
 
 void initWorldExporter(FILE *file);
+int initBinaryWorldExporter(FILE *file, int nRows, int nCols);
+void setWorldExporterThreads(int nThreads);
 void exportWorld(const int *world, int nRows, int nCols);
+void exportFrame(const int *world, int nRows, int nCols, int generation, long deathToll);
+int convertFramesToJson(FILE *in, FILE *out);
 
 #endif
@@ -0,0 +1,389 @@
+/**
+ * Synthetic workload generator. Writes a valid GOI input file built from the parameters on the command line.
+ *
+ * Output is produced one row at a time and only the previous row is kept in memory, so worlds far larger
+ * than RAM can be generated. The same parameters and seed always produce the same file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+
+// including the "dead faction": 0
+#define MAX_FACTIONS 10
+
+typedef enum
+{
+    TIMING_UNIFORM,
+    TIMING_EARLY,
+    TIMING_LATE,
+    TIMING_PERIODIC,
+} InvasionTiming;
+
+typedef struct
+{
+    long nRows;
+    long nCols;
+    int nGenerations;
+    int nFactions;
+    double density;
+    double clustering;
+    int nInvasions;
+    double invasionDensity;
+    InvasionTiming timing;
+    uint64_t seed;
+} GenOptions;
+
+typedef struct
+{
+    uint64_t s[4];
+} Rng;
+
+static void seedRng(Rng *rng, uint64_t seed);
+static uint64_t nextRandom(Rng *rng);
+static double nextUniform(Rng *rng);
+static int writeLayout(FILE *fp, Rng *rng, const GenOptions *options, double density, int *previousRow, char *line);
+static int *pickInvasionTimes(Rng *rng, const GenOptions *options);
+static int parseOptions(int argc, char *argv[], GenOptions *options, const char **outputPath);
+static void printUsage(const char *program);
+
+int main(int argc, char *argv[])
+{
+    GenOptions options;
+    const char *outputPath = NULL;
+    if (parseOptions(argc, argv, &options, &outputPath) == -1)
+    {
+        printUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *fp = stdout;
+    if (outputPath != NULL && strcmp(outputPath, "-") != 0)
+    {
+        fp = fopen(outputPath, "w");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Failed to open %s for writing. Aborting...\n", outputPath);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // one row of cells and one row of text; nothing else grows with the world
+    int *previousRow = malloc(sizeof(int) * options.nCols);
+    char *line = malloc(2 * options.nCols + 1);
+    if (previousRow == NULL || line == NULL)
+    {
+        fprintf(stderr, "No memory for a row of %ld cells. Aborting...\n", options.nCols);
+        exit(EXIT_FAILURE);
+    }
+
+    Rng rng;
+    seedRng(&rng, options.seed);
+    int *invasionTimes = pickInvasionTimes(&rng, &options);
+    if (invasionTimes == NULL)
+    {
+        fprintf(stderr, "No memory for invasion times. Aborting...\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int ret = fprintf(fp, "%d\n%ld\n%ld\n", options.nGenerations, options.nRows, options.nCols) < 0 ? -1 : 0;
+    if (ret == 0)
+    {
+        ret = writeLayout(fp, &rng, &options, options.density, previousRow, line);
+    }
+    if (ret == 0)
+    {
+        ret = fprintf(fp, "%d\n", options.nInvasions) < 0 ? -1 : 0;
+    }
+    for (int i = 0; i < options.nInvasions && ret == 0; i++)
+    {
+        ret = fprintf(fp, "%d\n", invasionTimes[i]) < 0 ? -1 : 0;
+        if (ret == 0)
+        {
+            ret = writeLayout(fp, &rng, &options, options.invasionDensity, previousRow, line);
+        }
+    }
+
+    if (fp != stdout ? fclose(fp) == EOF : fflush(fp) == EOF)
+    {
+        ret = -1;
+    }
+    if (ret == -1)
+    {
+        fprintf(stderr, "Failed to write output. Aborting...\n");
+        exit(EXIT_FAILURE);
+    }
+
+    free(invasionTimes);
+    free(line);
+    free(previousRow);
+    return 0;
+}
+
+/**
+ * Writes nRows lines of nCols cells. Each cell is, with probability clustering, a copy of its left or upper
+ * neighbour (so live cells form blobs), and otherwise alive with probability density, with a faction drawn
+ * uniformly from 1 to nFactions. Both choices keep the expected fraction of live cells at density.
+ *
+ * previousRow and line are scratch space of nCols cells and 2 * nCols + 1 characters. -1 is returned on error.
+ */
+static int writeLayout(FILE *fp, Rng *rng, const GenOptions *options, double density, int *previousRow, char *line)
+{
+    for (long row = 0; row < options->nRows; row++)
+    {
+        int left = 0;
+        for (long col = 0; col < options->nCols; col++)
+        {
+            int cell;
+            if (options->clustering > 0 && nextUniform(rng) < options->clustering && (row > 0 || col > 0))
+            {
+                bool fromLeft = row == 0 || (col > 0 && (nextRandom(rng) & 1));
+                cell = fromLeft ? left : previousRow[col];
+            }
+            else if (nextUniform(rng) < density)
+            {
+                cell = 1 + nextRandom(rng) % options->nFactions;
+            }
+            else
+            {
+                cell = 0;
+            }
+
+            // factions are single digits, so every cell is one character and a separator
+            line[2 * col] = '0' + cell;
+            line[2 * col + 1] = ' ';
+            previousRow[col] = cell;
+            left = cell;
+        }
+        line[2 * options->nCols - 1] = '\n';
+        if (fwrite(line, 1, 2 * options->nCols, fp) != (size_t) (2 * options->nCols))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Picks nInvasions distinct generations in [1, nGenerations] following the requested timing, in ascending
+ * order. Early and late timings skew the draw quadratically towards the start or end of the run. Draws that
+ * collide with an earlier one move to the next free generation.
+ *
+ * Returns a newly allocated array, or NULL if out of memory.
+ */
+static int *pickInvasionTimes(Rng *rng, const GenOptions *options)
+{
+    int nGenerations = options->nGenerations;
+    int *times = malloc(sizeof(int) * (options->nInvasions > 0 ? options->nInvasions : 1));
+    bool *taken = calloc(nGenerations + 1, sizeof(bool));
+    if (times == NULL || taken == NULL)
+    {
+        free(times);
+        free(taken);
+        return NULL;
+    }
+
+    for (int i = 0; i < options->nInvasions; i++)
+    {
+        int time;
+        double u = nextUniform(rng);
+        switch (options->timing)
+        {
+        case TIMING_EARLY:
+            time = 1 + (int) (nGenerations * u * u);
+            break;
+        case TIMING_LATE:
+            time = nGenerations - (int) (nGenerations * u * u);
+            break;
+        case TIMING_PERIODIC:
+            time = (int) ((long) (i + 1) * nGenerations / options->nInvasions);
+            break;
+        default:
+            time = 1 + (int) (nGenerations * u);
+            break;
+        }
+        if (time < 1 || time > nGenerations)
+        {
+            time = time < 1 ? 1 : nGenerations;
+        }
+        while (taken[time])
+        {
+            time = time == nGenerations ? 1 : time + 1;
+        }
+        taken[time] = true;
+    }
+
+    int n = 0;
+    for (int time = 1; time <= nGenerations; time++)
+    {
+        if (taken[time])
+        {
+            times[n++] = time;
+        }
+    }
+
+    free(taken);
+    return times;
+}
+
+// seedRng expands a 64-bit seed into xoshiro256** state with splitmix64.
+static void seedRng(Rng *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        seed += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+// nextRandom returns the next 64 bits from xoshiro256**.
+static uint64_t nextRandom(Rng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = ((s[1] * 5) << 7 | (s[1] * 5) >> 57) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+// nextUniform returns a double uniformly distributed in [0, 1).
+static double nextUniform(Rng *rng)
+{
+    return (nextRandom(rng) >> 11) * 0x1.0p-53;
+}
+
+// parseOptions fills options from the command line. -1 is returned, and the reason written to stderr, on error.
+static int parseOptions(int argc, char *argv[], GenOptions *options, const char **outputPath)
+{
+    *options = (GenOptions){
+        .nRows = 100,
+        .nCols = 100,
+        .nGenerations = 100,
+        .nFactions = 2,
+        .density = 0.3,
+        .clustering = 0,
+        .nInvasions = 0,
+        .invasionDensity = 0.05,
+        .timing = TIMING_UNIFORM,
+        .seed = 1,
+    };
+
+    static const struct option longOptions[] = {
+        {"rows", required_argument, NULL, 'r'},
+        {"cols", required_argument, NULL, 'c'},
+        {"generations", required_argument, NULL, 'g'},
+        {"factions", required_argument, NULL, 'f'},
+        {"density", required_argument, NULL, 'd'},
+        {"clustering", required_argument, NULL, 'k'},
+        {"invasions", required_argument, NULL, 'i'},
+        {"invasion-density", required_argument, NULL, 'D'},
+        {"timing", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"output", required_argument, NULL, 'o'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:", longOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            options->nRows = atol(optarg);
+            break;
+        case 'c':
+            options->nCols = atol(optarg);
+            break;
+        case 'g':
+            options->nGenerations = atoi(optarg);
+            break;
+        case 'f':
+            options->nFactions = atoi(optarg);
+            break;
+        case 'd':
+            options->density = atof(optarg);
+            break;
+        case 'k':
+            options->clustering = atof(optarg);
+            break;
+        case 'i':
+            options->nInvasions = atoi(optarg);
+            break;
+        case 'D':
+            options->invasionDensity = atof(optarg);
+            break;
+        case 't':
+            if (strcmp(optarg, "uniform") == 0)
+            {
+                options->timing = TIMING_UNIFORM;
+            }
+            else if (strcmp(optarg, "early") == 0)
+            {
+                options->timing = TIMING_EARLY;
+            }
+            else if (strcmp(optarg, "late") == 0)
+            {
+                options->timing = TIMING_LATE;
+            }
+            else if (strcmp(optarg, "periodic") == 0)
+            {
+                options->timing = TIMING_PERIODIC;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown --timing '%s'.\n", optarg);
+                return -1;
+            }
+            break;
+        case 's':
+            options->seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'o':
+            *outputPath = optarg;
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (options->nRows < 1 || options->nCols < 1 || options->nGenerations < 0)
+    {
+        fprintf(stderr, "--rows and --cols must be positive and --generations non-negative.\n");
+        return -1;
+    }
+    if (options->nFactions < 1 || options->nFactions >= MAX_FACTIONS)
+    {
+        fprintf(stderr, "--factions must be between 1 and %d.\n", MAX_FACTIONS - 1);
+        return -1;
+    }
+    if (options->density < 0 || options->density > 1 || options->invasionDensity < 0 || options->invasionDensity > 1 ||
+        options->clustering < 0 || options->clustering >= 1)
+    {
+        fprintf(stderr, "--density and --invasion-density must be in [0, 1], --clustering in [0, 1).\n");
+        return -1;
+    }
+    // invasion times must be distinct generations
+    if (options->nInvasions < 0 || options->nInvasions > options->nGenerations)
+    {
+        fprintf(stderr, "--invasions must be between 0 and --generations.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--rows N] [--cols N] [--generations N] [--factions N] [--density P] [--clustering P]\n"
+                    "       [--invasions N] [--invasion-density P] [--timing uniform|early|late|periodic] [--seed N] [-o <OUTPUT_PATH>]\n",
+            program);
+}
@@ -5,268 +5,1214 @@
 #include <ctype.h>
 #include <errno.h>
 #include "util.h"
-#include "exporter.h"
 #include "settings.h"
+#include "goi.h"
+#include "rules.h"
+#include "kernels.h"
+#include "profile.h"
+#include "perfcounters.h"
+#include "mapped.h"
+#include "sparse.h"
+#include "rle.h"
+#include "regions.h"
 #include <omp.h>
 
-// including the "dead faction": 0
-#define MAX_FACTIONS 10
+// observers a single context can hold
+#define MAX_OBSERVERS 8
 
-// this macro is here to make the code slightly more readable, not because it can be safely changed to
-// any integer value; changing this to a non-zero value may break the code
-#define DEAD_FACTION 0
-#define MUTEX_VALUE 1
+// the mapped engine sweeps the world in bands of about this many bytes, small enough that the source rows
+// being read and the rows being written stay resident together
+#define MAPPED_BAND_BYTES (32L << 20)
 
 /**
- * Specifies the number(s) of live neighbors of the same faction required for a dead cell to become alive.
+ * The state of one simulation. See goi.h for the public interface.
+ *
+ * Worlds are stored with a one-cell halo of DEAD_FACTION all around, (nRows + 2) x (nCols + 2) cells with a
+ * row stride of nCols + 2, so that the kernel can read all 8 neighbours of every cell without bounds checks.
+ * Off-grid cells have always counted as nobody's neighbour, which is exactly what a dead halo does. A toroidal
+ * world instead refreshes its halo from the opposite edges before every generation.
  */
-bool isBirthable(int n)
+struct GoiContext
 {
-    return n == 3;
+    GoiOptions options;
+    RuleTable rules;
+    int nRows;
+    int nCols;
+    int stride;
+    long capacity; // in cells, of each buffer
+
+    // world holds the current generation; nextWorld is scratch space that the kernel writes into
+    int *world;
+    int *nextWorld;
+    int *invaders;
+
+    // the mapped engine's scratch file descriptors, swapped along with the buffers; -1 for the dense engine
+    int worldFd;
+    int nextWorldFd;
+    int invadersFd;
+    long bandRows; // rows per band of the generation sweep
+
+    // the sparse and run-length engines keep their worlds here instead, and leave the buffers above empty
+    SparseWorld *sparse;
+    RleWorld *rle;
+
+    // picked by goi_reset from the factions that can be alive; the counting kernel runs in the generations
+    // whose population is observed, and the live-counting one in the others while the region index is kept
+    LiveFactions live;
+    RowKernel rowKernel;
+    RowKernel liveRowKernel;
+    RowKernel countingRowKernel;
+    GoiPopulationStats population;
+
+    // the region index, if enabled (regionTileSize > 0, kept across goi_reset), kept up to date every generation
+    RegionIndex *regions;
+    int regionTileSize;
+
+    // an unpadded copy of world for goi_world, refreshed on demand
+    int *view;
+    int viewGeneration;
+
+    // borrowed from the caller, see goi_create
+    int nInvasions;
+    const int *invasionTimes;
+    int **invasionPlans;
+    int invasionIndex;
+
+    int generation;
+    long deathToll;
+
+    // kept across goi_reset
+    int nObservers;
+    struct
+    {
+        GoiObserver observer;
+        int stride;
+        void *userData;
+        bool population; // wants the population counted
+    } observers[MAX_OBSERVERS];
+
+#if SAMPLE_PERF_COUNTERS
+    int perfWindow;
+    int perfWindowStart;
+    double perfWindowSeconds; // spent in goi_step on the window so far, which may span several calls
+    PerfCounts *perfCounts;   // counted so far in the window, by the threads of the context's team
+#endif
+};
+
+static int reserveBuffers(GoiContext *ctx, long nCells);
+static void freeBuffers(GoiContext *ctx);
+static bool isSupported(const GoiOptions *options);
+static unsigned scanLayout(const int *layout, long nCells);
+static long stepDense(GoiContext *ctx, const int *plan, GoiPopulationStats *population, PerfCounts *perfCounts);
+static long nextRowByTile(const GoiContext *ctx, RowKernel rowKernel, long row, const int *inv, GoiPopulationStats *population,
+                          long *tally);
+static void refreshHalo(GoiContext *ctx);
+static void prefetchBand(const GoiContext *ctx, const int *invaders, long firstRow, long lastRow);
+static void retireBand(const GoiContext *ctx, const int *invaders, long firstRow, long lastRow);
+static int addObserver(GoiContext *ctx, GoiObserver observer, int stride, void *userData, bool population);
+static GoiPopulationStats *startCounting(GoiContext *ctx, int generation);
+static void notifyObservers(GoiContext *ctx, long deaths, bool invaded, const GoiPopulationStats *population);
+#if SAMPLE_PERF_COUNTERS
+static void finishPerfWindow(GoiContext *ctx);
+#endif
+
+/**
+ * Fills options with the defaults: the dense engine and the standard rules, with as many threads as OpenMP
+ * would use.
+ */
+void goi_default_options(GoiOptions *options)
+{
+    options->nThreads = 0;
+    options->engine = GOI_ENGINE_DENSE;
+    options->topology = GOI_TOPOLOGY_BOUNDED;
+    goi_default_rules(&options->rules);
+    options->kernel = GOI_KERNEL_AUTO;
+    options->schedule = GOI_SCHEDULE_STATIC;
+    options->chunkSize = 0;
+    options->tileCols = 0;
 }
 
 /**
- * Specifies the number(s) of live neighbors of the same faction required for a live cell to remain alive.
+ * Parses an engine name, "dense", "mapped", "sparse" or "rle", into engine.
+ *
+ * -1 is returned, and engine left untouched, if the name is not recognised.
  */
-bool isSurvivable(int n)
+int goi_parse_engine(const char *name, GoiEngine *engine)
 {
-    return n == 2 || n == 3;
+    if (strcmp(name, "dense") == 0)
+    {
+        *engine = GOI_ENGINE_DENSE;
+        return 0;
+    }
+    if (strcmp(name, "mapped") == 0)
+    {
+        *engine = GOI_ENGINE_MAPPED;
+        return 0;
+    }
+    if (strcmp(name, "sparse") == 0)
+    {
+        *engine = GOI_ENGINE_SPARSE;
+        return 0;
+    }
+    if (strcmp(name, "rle") == 0)
+    {
+        *engine = GOI_ENGINE_RLE;
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * Parses a kernel name, "auto", "stencil", "window", "swar", "sse4.1", "avx2" or "avx512", into kernel.
+ *
+ * -1 is returned, and kernel left untouched, if the name is not recognised.
+ */
+int goi_parse_kernel(const char *name, GoiKernel *kernel)
+{
+    for (GoiKernel candidate = GOI_KERNEL_AUTO; candidate <= GOI_KERNEL_AVX512; candidate++)
+    {
+        if (strcmp(name, goi_kernel_name(candidate)) == 0)
+        {
+            *kernel = candidate;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the name of kernel, as goi_parse_kernel takes it.
+ */
+const char *goi_kernel_name(GoiKernel kernel)
+{
+    switch (kernel)
+    {
+    case GOI_KERNEL_STENCIL:
+        return "stencil";
+    case GOI_KERNEL_WINDOW:
+        return "window";
+    case GOI_KERNEL_SWAR:
+        return "swar";
+    case GOI_KERNEL_SSE41:
+        return "sse4.1";
+    case GOI_KERNEL_AVX2:
+        return "avx2";
+    case GOI_KERNEL_AVX512:
+        return "avx512";
+    default:
+        return "auto";
+    }
+}
+
+/**
+ * Resolves kernel to the row kernel that a context created with it runs on this CPU. GOI_KERNEL_AUTO becomes
+ * the kernel named by the GOI_KERNEL environment variable if it is set (and not "auto"), and otherwise the
+ * fastest kernel that the CPU supports; goi_create does the same.
+ *
+ * -1 is returned, and kernel left untouched, if GOI_KERNEL is not a kernel name or the kernel needs an
+ * instruction set that the CPU lacks.
+ */
+int goi_select_kernel(GoiKernel *kernel)
+{
+    GoiKernel selected = *kernel;
+    const char *override = getenv("GOI_KERNEL");
+    if (selected == GOI_KERNEL_AUTO && override != NULL && override[0] != '\0' &&
+        goi_parse_kernel(override, &selected) == -1)
+    {
+        return -1;
+    }
+    if (selected == GOI_KERNEL_AUTO)
+    {
+        selected = bestRowKernel();
+    }
+    if (!rowKernelSupported(selected))
+    {
+        return -1;
+    }
+    *kernel = selected;
+    return 0;
 }
 
 /**
- * Specifies the number of live neighbors of a different faction required for a live cell to die due to fighting.
+ * Parses a schedule name, "static", "dynamic" or "guided", into schedule.
+ *
+ * -1 is returned, and schedule left untouched, if the name is not recognised.
  */
-bool willFight(int n) {
-    return n > 0;
+int goi_parse_schedule(const char *name, GoiSchedule *schedule)
+{
+    for (GoiSchedule candidate = GOI_SCHEDULE_STATIC; candidate <= GOI_SCHEDULE_GUIDED; candidate++)
+    {
+        if (strcmp(name, goi_schedule_name(candidate)) == 0)
+        {
+            *schedule = candidate;
+            return 0;
+        }
+    }
+    return -1;
 }
 
 /**
- * Computes and returns the next state of the cell specified by row and col based on currWorld and invaders. Sets *diedDueToFighting to
- * true if this cell should count towards the death toll due to fighting.
- * 
- * invaders can be NULL if there are no invaders.
+ * Returns the name of schedule, as goi_parse_schedule takes it.
  */
-int getNextState(const int *currWorld, const int *invaders, int nRows, int nCols, int row, int col, bool *diedDueToFighting)
+const char *goi_schedule_name(GoiSchedule schedule)
 {
-    // we'll explicitly set if it was death due to fighting
-    *diedDueToFighting = false;
+    switch (schedule)
+    {
+    case GOI_SCHEDULE_DYNAMIC:
+        return "dynamic";
+    case GOI_SCHEDULE_GUIDED:
+        return "guided";
+    default:
+        return "static";
+    }
+}
 
-    // faction of this cell
-    int cellFaction = getValueAt(currWorld, nRows, nCols, row, col);
+/**
+ * Parses a topology name, "bounded", "toroidal" (or "torus") or "unbounded", into topology.
+ *
+ * -1 is returned, and topology left untouched, if the name is not recognised.
+ */
+int goi_parse_topology(const char *name, GoiTopology *topology)
+{
+    if (strcmp(name, "bounded") == 0)
+    {
+        *topology = GOI_TOPOLOGY_BOUNDED;
+        return 0;
+    }
+    if (strcmp(name, "toroidal") == 0 || strcmp(name, "torus") == 0)
+    {
+        *topology = GOI_TOPOLOGY_TOROIDAL;
+        return 0;
+    }
+    if (strcmp(name, "unbounded") == 0)
+    {
+        *topology = GOI_TOPOLOGY_UNBOUNDED;
+        return 0;
+    }
+    return -1;
+}
 
-    // did someone just get landed on? the value is overriden by the invasion at this position
-    if (invaders != NULL && getValueAt(invaders, nRows, nCols, row, col) != DEAD_FACTION)
+/**
+ * Creates a simulation context positioned at generation 0 of startWorld. options may be NULL for the defaults.
+ *
+ * startWorld is copied. invasionTimes and invasionPlans are borrowed, not copied: they must stay valid and
+ * unchanged until the context is destroyed or reset. invasionTimes must be in ascending order.
+ *
+ * Returns NULL if options are invalid (including a topology the engine does not support, or a kernel the CPU
+ * does not, see goi_select_kernel), a cell is not a faction in [0, 9], or memory could not be allocated.
+ */
+GoiContext *goi_create(const GoiOptions *options, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
+{
+    GoiContext *ctx = calloc(1, sizeof(GoiContext));
+    if (ctx == NULL)
     {
-        *diedDueToFighting = cellFaction != DEAD_FACTION;
-        return getValueAt(invaders, nRows, nCols, row, col);
+        return NULL;
     }
 
-    // tracks count of each faction adjacent to this cell
-    int neighborCounts[MAX_FACTIONS];
-    memset(neighborCounts, 0, MAX_FACTIONS * sizeof(int));
+    if (options != NULL)
+    {
+        ctx->options = *options;
+    }
+    else
+    {
+        goi_default_options(&ctx->options);
+    }
+    if (ctx->options.nThreads <= 0)
+    {
+        ctx->options.nThreads = omp_get_max_threads();
+    }
+#if SAMPLE_PERF_COUNTERS
+    ctx->perfCounts = createPerfCounts(ctx->options.nThreads);
+    if (ctx->perfCounts == NULL)
+    {
+        free(ctx);
+        return NULL;
+    }
+#endif
+    compileRules(&ctx->options.rules, &ctx->rules);
+    ctx->worldFd = ctx->nextWorldFd = ctx->invadersFd = -1;
+    if (goi_select_kernel(&ctx->options.kernel) == -1 || !isSupported(&ctx->options) ||
+        (ctx->options.engine == GOI_ENGINE_SPARSE && (ctx->sparse = createSparseWorld()) == NULL) ||
+        (ctx->options.engine == GOI_ENGINE_RLE && (ctx->rle = createRleWorld()) == NULL) ||
+        goi_reset(ctx, startWorld, nRows, nCols, nInvasions, invasionTimes, invasionPlans) == -1)
+    {
+        goi_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
 
-    // count neighbors (and self)
-    for (int dy = -1; dy <= 1; dy++)
+/**
+ * Repositions ctx at generation 0 of a new world, keeping its options. The world buffers are reused when the
+ * new world fits in them, so resetting between same-sized worlds does not allocate.
+ *
+ * The same ownership rules as goi_create apply. -1 is returned if a cell is not a faction in [0, 9] or memory
+ * could not be allocated, in which case ctx may only be destroyed.
+ */
+int goi_reset(GoiContext *ctx, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
+{
+#if SAMPLE_PERF_COUNTERS
+    finishPerfWindow(ctx);
+#endif
+    if (nRows <= 0 || nCols <= 0)
+    {
+        return -1;
+    }
+    unsigned present = scanLayout(startWorld, (long) nRows * nCols);
+    for (int i = 0; i < nInvasions; i++)
+    {
+        present |= scanLayout(invasionPlans[i], (long) nRows * nCols);
+    }
+    if (present & ~((1u << MAX_FACTIONS) - 1))
     {
-        for (int dx = -1; dx <= 1; dx++)
+        return -1;
+    }
+
+    // pick the row kernel specialised for the number of factions that can ever be alive
+    ctx->live.nFactions = 0;
+    for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    {
+        if (present & (1u << faction))
         {
-            int faction = getValueAt(currWorld, nRows, nCols, row + dy, col + dx);
-            if (faction >= DEAD_FACTION)
-            {
-                neighborCounts[faction]++;
-            }
+            ctx->live.factions[ctx->live.nFactions++] = faction;
         }
     }
+    if (ctx->live.nFactions == 0)
+    {
+        // nothing will ever live; any faction will do
+        ctx->live.factions[0] = DEAD_FACTION + 1;
+    }
+    ctx->rowKernel = selectRowKernel(&ctx->live, COUNT_NOTHING, ctx->options.kernel);
+    ctx->liveRowKernel = selectRowKernel(&ctx->live, COUNT_LIVE, ctx->options.kernel);
+    ctx->countingRowKernel = selectRowKernel(&ctx->live, COUNT_ALL, ctx->options.kernel);
 
-    // we counted this cell as its "neighbor"; adjust for this
-    neighborCounts[cellFaction]--;
+    PROFILE_START(PHASE_INIT);
+    ctx->nInvasions = nInvasions;
+    ctx->invasionTimes = invasionTimes;
+    ctx->invasionPlans = invasionPlans;
+    ctx->invasionIndex = 0;
+    ctx->generation = 0;
+    ctx->deathToll = 0;
+    ctx->viewGeneration = -1;
+#if SAMPLE_PERF_COUNTERS
+    ctx->perfWindow = getPerfWindow();
+    ctx->perfWindowStart = 1;
+    ctx->perfWindowSeconds = 0;
+#endif
 
-    if (cellFaction == DEAD_FACTION)
+    if (ctx->sparse != NULL)
+    {
+        // the view is the only thing sized by the bounds, and is sized again on demand
+        free(ctx->view);
+        ctx->view = NULL;
+        ctx->nRows = nRows;
+        ctx->nCols = nCols;
+        int ret = loadSparseWorld(ctx->sparse, startWorld, nRows, nCols, ctx->options.topology == GOI_TOPOLOGY_BOUNDED);
+        PROFILE_END(PHASE_INIT);
+        return ret;
+    }
+    if (ctx->rle != NULL)
     {
-        // this is a dead cell; we need to see if a birth is possible:
-        // need exactly 3 of a single faction; we don't care about other factions
+        free(ctx->view);
+        ctx->view = NULL;
+        ctx->nRows = nRows;
+        ctx->nCols = nCols;
+        int ret = loadRleWorld(ctx->rle, startWorld, nRows, nCols, nInvasions, invasionPlans);
+        PROFILE_END(PHASE_INIT);
+        return ret;
+    }
 
-        // by default, no birth
-        int newFaction = DEAD_FACTION;
+    int stride = nCols + 2;
+    if (reserveBuffers(ctx, (long) (nRows + 2) * stride) == -1)
+    {
+        return -1;
+    }
+
+    // init the world!
+    // we make a copy because we do not own startWorld; the halo of both buffers is dead and is never written
+    // again, as the kernel only writes inside it
+    ctx->nRows = nRows;
+    ctx->nCols = nCols;
+    ctx->stride = stride;
+    ctx->bandRows = nRows;
+    if (ctx->options.engine == GOI_ENGINE_MAPPED)
+    {
+        ctx->bandRows = MAPPED_BAND_BYTES / ((long) sizeof(int) * stride);
+        ctx->bandRows = ctx->bandRows < 1 ? 1 : ctx->bandRows;
+    }
+    memset(ctx->world, 0, sizeof(int) * stride);
+    memset(ctx->nextWorld, 0, sizeof(int) * stride);
+    memset(ctx->world + (long) (nRows + 1) * stride, 0, sizeof(int) * stride);
+    memset(ctx->nextWorld + (long) (nRows + 1) * stride, 0, sizeof(int) * stride);
+    for (int row = 0; row < nRows; row++)
+    {
+        int *paddedRow = ctx->world + (long) (row + 1) * stride;
+        paddedRow[0] = DEAD_FACTION;
+        memcpy(paddedRow + 1, startWorld + (long) row * nCols, sizeof(int) * nCols);
+        paddedRow[nCols + 1] = DEAD_FACTION;
+        ctx->nextWorld[(long) (row + 1) * stride] = DEAD_FACTION;
+        ctx->nextWorld[(long) (row + 1) * stride + nCols + 1] = DEAD_FACTION;
+    }
 
-        // start at 1 because we ignore dead neighbors
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    if (ctx->regionTileSize > 0)
+    {
+        freeRegionIndex(ctx->regions);
+        ctx->regions = createRegionIndex(nRows, nCols, ctx->regionTileSize);
+        if (ctx->regions == NULL)
         {
-            int count = neighborCounts[faction];
-            if (isBirthable(count))
-            {
-                newFaction = faction;
-            }
+            return -1;
         }
+        loadRegionIndex(ctx->regions, startWorld);
+    }
+    PROFILE_END(PHASE_INIT);
+    return 0;
+}
 
-        return newFaction;
+/**
+ * Frees ctx and everything it owns. Does nothing if ctx is NULL.
+ */
+void goi_destroy(GoiContext *ctx)
+{
+    if (ctx == NULL)
+    {
+        return;
     }
-    else
+#if SAMPLE_PERF_COUNTERS
+    finishPerfWindow(ctx);
+#endif
+    PROFILE_START(PHASE_SWAP);
+    freeBuffers(ctx);
+    freeSparseWorld(ctx->sparse);
+    freeRleWorld(ctx->rle);
+    freeRegionIndex(ctx->regions);
+#if SAMPLE_PERF_COUNTERS
+    freePerfCounts(ctx->perfCounts);
+#endif
+    free(ctx);
+    PROFILE_END(PHASE_SWAP);
+}
+
+/**
+ * Advances the simulation by nGenerations generations. Nothing is printed or written.
+ *
+ * Only parallel regions opened here use the context's thread count, so contexts can be stepped from inside
+ * an enclosing parallel region to run several small simulations side by side.
+ *
+ * Returns 0, or -1 if nGenerations is negative or the sparse or run-length engine ran out of memory, in which case ctx may
+ * only be destroyed.
+ */
+int goi_step(GoiContext *ctx, int nGenerations)
+{
+    if (nGenerations < 0)
     {
-        /** 
-         * this is a live cell; we follow the usual rules:
-         * Death (fighting): > 0 hostile neighbor
-         * Death (underpopulation): < 2 friendly neighbors and 0 hostile neighbors
-         * Death (overpopulation): > 3 friendly neighbors and 0 hostile neighbors
-         * Survival: 2 or 3 friendly neighbors and 0 hostile neighbors
-         */
+        return -1;
+    }
+
+#if SAMPLE_PERF_COUNTERS
+    double perfStart = getWallTime();
+    PerfCounts *perfCounts = ctx->perfCounts;
+#else
+    PerfCounts *perfCounts = NULL;
+#endif
 
-        int hostileCount = 0;
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    int lastGeneration = ctx->generation + nGenerations;
+    for (int i = ctx->generation + 1; i <= lastGeneration; i++)
+    {
+        // is there an invasion this generation?
+        const int *plan = NULL;
+        if (ctx->invasionIndex < ctx->nInvasions && i == ctx->invasionTimes[ctx->invasionIndex])
         {
-            if (faction == cellFaction)
+            plan = ctx->invasionPlans[ctx->invasionIndex];
+            ctx->invasionIndex++;
+        }
+
+        // the population is only counted for the generations someone will see
+        GoiPopulationStats *population = ctx->nObservers > 0 ? startCounting(ctx, i) : NULL;
+
+        long deathToll;
+        if (ctx->sparse != NULL)
+        {
+            PROFILE_START(PHASE_KERNEL);
+            deathToll = stepSparseWorld(ctx->sparse, &ctx->rules, population != NULL ? ctx->countingRowKernel : ctx->rowKernel,
+                                        &ctx->live, plan, population, ctx->options.nThreads, perfCounts);
+            PROFILE_END(PHASE_KERNEL);
+            if (deathToll == -1)
             {
-                continue;
+                return -1;
             }
-            hostileCount += neighborCounts[faction];
         }
-
-        if (willFight(hostileCount))
+        else if (ctx->rle != NULL)
+        {
+            PROFILE_START(PHASE_KERNEL);
+            deathToll = stepRleWorld(ctx->rle, &ctx->rules, population != NULL ? ctx->countingRowKernel : ctx->rowKernel, &ctx->live,
+                                     plan != NULL ? ctx->invasionIndex - 1 : -1, population, ctx->options.nThreads, perfCounts);
+            PROFILE_END(PHASE_KERNEL);
+            if (deathToll == -1)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            deathToll = stepDense(ctx, plan, population, perfCounts);
+        }
+        if (population != NULL)
         {
-            *diedDueToFighting = true;
-            return DEAD_FACTION;
+            // the kernels only see the cells they compute, which leaves out the dead chunks of a sparse world
+            population->live[DEAD_FACTION] = 0;
+            if (ctx->options.topology != GOI_TOPOLOGY_UNBOUNDED)
+            {
+                population->live[DEAD_FACTION] = (long) ctx->nRows * ctx->nCols;
+                for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+                {
+                    population->live[DEAD_FACTION] -= population->live[faction];
+                }
+            }
         }
+        ctx->deathToll += deathToll;
+        ctx->generation = i;
 
-        int friendlyCount = neighborCounts[cellFaction];
-        if (!isSurvivable(friendlyCount))
+#if SAMPLE_PERF_COUNTERS
+        // a window left open when the call returns is carried over to the next one, or closed by finishPerfWindow
+        if (i % ctx->perfWindow == 0)
         {
-            return DEAD_FACTION;
+            double now = getWallTime();
+            reportPerfWindow(ctx->perfCounts, ctx->perfWindowStart, i, ctx->perfWindowSeconds + now - perfStart);
+            ctx->perfWindowStart = i + 1;
+            ctx->perfWindowSeconds = 0;
+            perfStart = now;
         }
+#endif
 
-        return cellFaction;
+        // a single well-predicted branch per generation when nobody is watching
+        if (ctx->nObservers > 0)
+        {
+            notifyObservers(ctx, deathToll, plan != NULL, population);
+        }
     }
+
+#if SAMPLE_PERF_COUNTERS
+    ctx->perfWindowSeconds += getWallTime() - perfStart;
+#endif
+    return 0;
 }
 
 /**
- * The main simulation logic.
- * 
- * goi does not own startWorld, invasionTimes or invasionPlans and should not modify or attempt to free them.
- * nThreads is the number of threads to simulate with. It is ignored by the sequential implementation.
+ * Registers observer to be called with userData after every generation that is a multiple of stride.
+ * Observers are called in the order they were added and stay registered across goi_reset.
+ *
+ * -1 is returned if stride is not positive or the context already holds the maximum number of observers.
  */
-int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
+int goi_add_observer(GoiContext *ctx, GoiObserver observer, int stride, void *userData)
+{
+    return addObserver(ctx, observer, stride, userData, false);
+}
+
+/**
+ * Registers observer as goi_add_observer does, except that the generations it sees also have their
+ * population counted (see GoiPopulationStats) and passed in stats->population. Counting slows those
+ * generations down a little, so a large stride keeps the cost down.
+ */
+int goi_add_population_observer(GoiContext *ctx, GoiObserver observer, int stride, void *userData)
+{
+    return addObserver(ctx, observer, stride, userData, true);
+}
+
+/**
+ * Unregisters all observers.
+ */
+void goi_clear_observers(GoiContext *ctx)
 {
-    // death toll due to fighting
-    int deathToll = 0;
-    int threads;
-    // set the number of threads for OpenMP here
-    omp_set_num_threads(nThreads);
+    ctx->nObservers = 0;
+}
 
-    #pragma omp parallel
+/**
+ * Starts keeping a region index of ctx in tiles of tileSize x tileSize cells, from the current generation
+ * on, or stops keeping one if tileSize is 0. The index holds the population of every faction in every tile,
+ * summed up a pyramid, so that goi_region_population answers for any rectangle of tiles without reading the
+ * world. It is kept up to date by the kernel as it goes, which slows every generation down a little, and is
+ * rebuilt by goi_reset.
+ *
+ * -1 is returned if tileSize is negative, ctx uses the sparse or run-length engine, or out of memory.
+ */
+int goi_enable_regions(GoiContext *ctx, int tileSize)
+{
+    if (tileSize < 0 || (tileSize > 0 && (ctx->sparse != NULL || ctx->rle != NULL)))
+    {
+        return -1;
+    }
+    freeRegionIndex(ctx->regions);
+    ctx->regions = NULL;
+    ctx->regionTileSize = 0;
+    if (tileSize == 0)
     {
-        threads = omp_get_num_threads();
+        return 0;
     }
-    printf("Number of threads used for parallel: %i\n", threads);
 
-    // init the world!
-    // we make a copy because we do not own startWorld (and will perform free() on world)
-    // TODO: POTENTIAL to parallelise 
-    int *world = malloc(sizeof(int) * nRows * nCols); // the 2d matrix is located in a contiguous memory space
-    if (world == NULL)
+    const int *world = goi_world(ctx);
+    ctx->regions = world != NULL ? createRegionIndex(ctx->nRows, ctx->nCols, tileSize) : NULL;
+    if (ctx->regions == NULL)
     {
         return -1;
     }
-    for (int row = 0; row < nRows; row++)
+    loadRegionIndex(ctx->regions, world);
+    ctx->regionTileSize = tileSize;
+    return 0;
+}
+
+/**
+ * Returns the tile size of the region index of ctx, or 0 if it has none.
+ */
+int goi_region_tile_size(const GoiContext *ctx)
+{
+    return ctx->regionTileSize;
+}
+
+/**
+ * Sets counts to the population of each faction, dead cells included, in the nTileRows x nTileCols tiles of
+ * the region index from tile (tileRow, tileCol), as of the current generation. Tile (r, c) holds the cells
+ * from (r * tileSize, c * tileSize); those of the last row and column of tiles may be cut short by the edges.
+ * Takes O(log^2) of the number of tiles.
+ *
+ * -1 is returned if ctx has no region index or the rectangle is empty or not within the world.
+ */
+int goi_region_population(const GoiContext *ctx, int tileRow, int tileCol, int nTileRows, int nTileCols,
+                          long counts[GOI_MAX_FACTIONS])
+{
+    if (ctx->regions == NULL)
     {
-        for (int col = 0; col < nCols; col++)
+        return -1;
+    }
+    return queryRegionIndex(ctx->regions, tileRow, tileCol, nTileRows, nTileCols, counts);
+}
+
+/**
+ * Returns the population of every tile of the region index of ctx, as of the current generation:
+ * GOI_MAX_FACTIONS counts per tile, tiles in row-major order, *nTileRows x *nTileCols of them. The pointer is
+ * invalidated by the next call to goi_step, goi_reset, goi_enable_regions or goi_destroy.
+ *
+ * NULL is returned if ctx has no region index.
+ */
+const long *goi_region_tiles(const GoiContext *ctx, int *nTileRows, int *nTileCols)
+{
+    if (ctx->regions == NULL)
+    {
+        return NULL;
+    }
+    *nTileRows = regionTileRows(ctx->regions);
+    *nTileCols = regionTileCols(ctx->regions);
+    return regionTiles(ctx->regions);
+}
+
+/**
+ * Returns the current world, nRows * nCols cells in row-major order, or NULL if out of memory. The pointer
+ * is invalidated by the next call to goi_step, goi_reset or goi_destroy.
+ *
+ * The world is copied out of the context's padded buffers, chunks or runs, the first time it is asked for in a
+ * generation. An unbounded world is cut down to its original bounds.
+ */
+const int *goi_world(GoiContext *ctx)
+{
+    if (ctx->view == NULL)
+    {
+        if (ctx->sparse != NULL || ctx->rle != NULL)
+        {
+            ctx->view = malloc(sizeof(int) * ctx->nRows * ctx->nCols);
+        }
+        else
         {
-            setValueAt(world, nRows, nCols, row, col, getValueAt(startWorld, nRows, nCols, row, col));
+            ctx->view = ctx->options.engine == GOI_ENGINE_MAPPED ? mapCells(ctx->capacity, NULL) : malloc(sizeof(int) * ctx->capacity);
         }
+        if (ctx->view == NULL)
+        {
+            return NULL;
+        }
+    }
+    if (ctx->sparse != NULL && ctx->viewGeneration != ctx->generation)
+    {
+        copySparseWorld(ctx->sparse, ctx->view);
+        ctx->viewGeneration = ctx->generation;
+    }
+    if (ctx->rle != NULL && ctx->viewGeneration != ctx->generation)
+    {
+        copyRleWorld(ctx->rle, ctx->view);
+        ctx->viewGeneration = ctx->generation;
     }
+    if (ctx->viewGeneration != ctx->generation)
+    {
+        for (int row = 0; row < ctx->nRows; row++)
+        {
+            memcpy(ctx->view + (long) row * ctx->nCols, ctx->world + (long) (row + 1) * ctx->stride + 1, sizeof(int) * ctx->nCols);
+        }
+        ctx->viewGeneration = ctx->generation;
+    }
+    return ctx->view;
+}
 
-#if PRINT_GENERATIONS
-    printf("\n=== WORLD 0 ===\n");
-    printWorld(world, nRows, nCols);
-#endif
+/**
+ * Returns the options ctx was created with, with the thread count resolved.
+ */
+const GoiOptions *goi_options(const GoiContext *ctx)
+{
+    return &ctx->options;
+}
 
-#if EXPORT_GENERATIONS
-    exportWorld(world, nRows, nCols);
-#endif
+int goi_rows(const GoiContext *ctx)
+{
+    return ctx->nRows;
+}
+
+int goi_cols(const GoiContext *ctx)
+{
+    return ctx->nCols;
+}
+
+/**
+ * Returns the number of generations simulated since the context was created or last reset.
+ */
+int goi_generation(const GoiContext *ctx)
+{
+    return ctx->generation;
+}
 
-    // Begin simulating
-    int invasionIndex = 0;
-    for (int i = 1; i <= nGenerations; i++)
+/**
+ * Returns the number of deaths due to fighting so far.
+ */
+long goi_death_toll(const GoiContext *ctx)
+{
+    return ctx->deathToll;
+}
+
+/**
+ * Makes sure each of the buffers can hold nCells cells, growing them if required.
+ * -1 is returned if memory could not be allocated, in which case the buffers are left empty.
+ */
+static int reserveBuffers(GoiContext *ctx, long nCells)
+{
+    if (nCells <= ctx->capacity)
     {
-        // is there an invasion this generation?
-        int *inv = NULL;
-        if (invasionIndex < nInvasions && i == invasionTimes[invasionIndex])
+        return 0;
+    }
+
+    freeBuffers(ctx);
+    ctx->capacity = nCells; // set first, so that freeBuffers knows the size of a partial mapping
+    if (ctx->options.engine == GOI_ENGINE_MAPPED)
+    {
+        ctx->world = mapCells(nCells, &ctx->worldFd);
+        ctx->nextWorld = mapCells(nCells, &ctx->nextWorldFd);
+        ctx->invaders = mapCells(nCells, &ctx->invadersFd);
+    }
+    else
+    {
+        ctx->world = malloc(sizeof(int) * nCells);
+        ctx->nextWorld = malloc(sizeof(int) * nCells);
+        ctx->invaders = malloc(sizeof(int) * nCells);
+    }
+    if (ctx->world == NULL || ctx->nextWorld == NULL || ctx->invaders == NULL)
+    {
+        freeBuffers(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+static void freeBuffers(GoiContext *ctx)
+{
+    if (ctx->options.engine == GOI_ENGINE_MAPPED)
+    {
+        unmapCells(ctx->world, ctx->capacity, ctx->worldFd);
+        unmapCells(ctx->nextWorld, ctx->capacity, ctx->nextWorldFd);
+        unmapCells(ctx->invaders, ctx->capacity, ctx->invadersFd);
+        unmapCells(ctx->view, ctx->capacity, -1);
+        ctx->worldFd = ctx->nextWorldFd = ctx->invadersFd = -1;
+    }
+    else
+    {
+        free(ctx->world);
+        free(ctx->nextWorld);
+        free(ctx->invaders);
+        free(ctx->view);
+    }
+    ctx->world = NULL;
+    ctx->nextWorld = NULL;
+    ctx->invaders = NULL;
+    ctx->view = NULL;
+    ctx->capacity = 0;
+}
+
+/**
+ * Returns whether the engine of options supports its topology: only the sparse engine can grow past the
+ * bounds, and it cannot wrap around them; the run-length engine keeps to them.
+ */
+static bool isSupported(const GoiOptions *options)
+{
+    switch (options->engine)
+    {
+    case GOI_ENGINE_DENSE:
+    case GOI_ENGINE_MAPPED:
+        return options->topology == GOI_TOPOLOGY_BOUNDED || options->topology == GOI_TOPOLOGY_TOROIDAL;
+    case GOI_ENGINE_SPARSE:
+        return options->topology == GOI_TOPOLOGY_BOUNDED || options->topology == GOI_TOPOLOGY_UNBOUNDED;
+    case GOI_ENGINE_RLE:
+        return options->topology == GOI_TOPOLOGY_BOUNDED;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Returns a bit mask of the factions present in layout, bit f for faction f. A cell outside [0, MAX_FACTIONS),
+ * which the kernels cannot count, sets bit 31.
+ */
+static unsigned scanLayout(const int *layout, long nCells)
+{
+    unsigned present = 0;
+    for (long i = 0; i < nCells; i++)
+    {
+        unsigned cell = layout[i];
+        present |= 1u << (cell < MAX_FACTIONS ? cell : 31);
+    }
+    return present;
+}
+
+/**
+ * Advances the dense or mapped world of ctx by one generation, with plan (or nobody, if NULL) invading. If
+ * population is not NULL the generation's population is added to it.
+ * Returns the number of deaths due to fighting.
+ */
+static long stepDense(GoiContext *ctx, const int *plan, GoiPopulationStats *population, PerfCounts *perfCounts)
+{
+    int nRows = ctx->nRows;
+    int nCols = ctx->nCols;
+    int stride = ctx->stride;
+    int nThreads = ctx->options.nThreads;
+    const RuleTable *rules = &ctx->rules;
+    const LiveFactions *live = &ctx->live;
+    long *tally = ctx->regions != NULL ? beginRegionTally(ctx->regions) : NULL;
+    RowKernel rowKernel = population != NULL ? ctx->countingRowKernel : (tally != NULL ? ctx->liveRowKernel : ctx->rowKernel);
+    bool mapped = ctx->options.engine == GOI_ENGINE_MAPPED;
+    long bandRows = ctx->bandRows;
+    const int *world = ctx->world;
+    int *wholeNewWorld = ctx->nextWorld;
+
+    // under a torus the halo mirrors the opposite edges, so the kernel needs no wrap-around of its own
+    if (ctx->options.topology == GOI_TOPOLOGY_TOROIDAL)
+    {
+        PROFILE_START(PHASE_HALO);
+        refreshHalo(ctx);
+        PROFILE_END(PHASE_HALO);
+    }
+
+    const int *inv = NULL;
+    if (plan != NULL)
+    {
+        // we make a copy, in the padded layout, because we do not own invasionPlans
+        PROFILE_START(PHASE_INVASION_COPY);
+        int *invaders = ctx->invaders;
+        #pragma omp parallel for num_threads(nThreads)
+        for (int rowInv = 0; rowInv < nRows; rowInv++)
         {
-            // we make a copy because we do not own invasionPlans
-            inv = malloc(sizeof(int) * nRows * nCols);
-            if (inv == NULL)
+            memcpy(invaders + (long) (rowInv + 1) * stride + 1, plan + (long) rowInv * nCols, sizeof(int) * nCols);
+        }
+        inv = invaders;
+        PROFILE_END(PHASE_INVASION_COPY);
+    }
+
+    // the world is swept in strips of tileCols columns if asked to, each strip top to bottom, so that the
+    // rows around the one being computed are still in cache when it is reached; the region index cuts rows
+    // into tiles its own way
+    int tileCols = ctx->options.tileCols > 0 && ctx->options.tileCols < nCols && tally == NULL ? ctx->options.tileCols : nCols;
+    int nStrips = (nCols + tileCols - 1) / tileCols;
+    omp_sched_t schedule = ctx->options.schedule == GOI_SCHEDULE_DYNAMIC  ? omp_sched_dynamic
+                           : ctx->options.schedule == GOI_SCHEDULE_GUIDED ? omp_sched_guided
+                                                                          : omp_sched_static;
+
+    // get new states for each cell
+    // each thread keeps its own tally which is summed once at the end of the loop, rather than
+    // serialising every fighting death through a critical section; the same goes for the population
+    long deathToll = 0;
+    PROFILE_START(PHASE_KERNEL);
+    #pragma omp parallel num_threads(nThreads) reduction(+:deathToll)
+    {
+        GoiPopulationStats threadPopulation = {0};
+        // set in each thread's own environment, for the loop below only, so the caller's is left alone
+        omp_set_schedule(schedule, ctx->options.chunkSize);
+        PROFILE_THREAD_START();
+        PERF_THREAD_START();
+        // the dense engine sweeps the whole world as one band; the mapped engine goes band by band, so that
+        // the pages of each can be read ahead before it is reached and written back once it is done
+        for (long firstRow = 1; firstRow <= nRows; firstRow += bandRows)
+        {
+            long lastRow = firstRow + bandRows - 1 < nRows ? firstRow + bandRows - 1 : nRows;
+            if (mapped)
             {
-                free(world);
-                return -1;
+                #pragma omp single nowait
+                prefetchBand(ctx, inv, lastRow + 1, lastRow + bandRows);
             }
-            // POTENTIAL to loop-level parallelise
-            int rowInv;
-            int colInv;
-            #pragma omp parallel for shared(inv, invasionPlans) private (rowInv, colInv)
-            for (rowInv = 0; rowInv < nRows; rowInv++)
+
+            // nowait so that each thread's time stops when its own rows are done, not at the barrier
+            #pragma omp for collapse(2) schedule(runtime) nowait
+            for (int strip = 0; strip < nStrips; strip++)
             {
-                for (colInv = 0; colInv < nCols; colInv++)
-                {   
-                    setValueAt(inv, nRows, nCols, rowInv, colInv, getValueAt(invasionPlans[invasionIndex], nRows, nCols, rowInv, colInv));
+                for (long row = firstRow; row <= lastRow; row++)
+                {
+                    if (tally != NULL)
+                    {
+                        deathToll += nextRowByTile(ctx, rowKernel, row, inv, population != NULL ? &threadPopulation : NULL, tally);
+                        continue;
+                    }
+                    int col = strip * tileCols;
+                    int width = tileCols < nCols - col ? tileCols : nCols - col;
+                    long offset = row * stride + 1 + col;
+                    deathToll += rowKernel(rules, live, world + offset - stride, world + offset, world + offset + stride,
+                                           inv != NULL ? inv + offset : NULL, wholeNewWorld + offset, width, &threadPopulation);
                 }
             }
-            invasionIndex++;
-        }
 
-        // create the next world state
-        int *wholeNewWorld = malloc(sizeof(int) * nRows * nCols);
-        if (wholeNewWorld == NULL)
-        {
-            if (inv != NULL)
+            if (mapped)
             {
-                free(inv);
+                #pragma omp barrier
+                #pragma omp single nowait
+                retireBand(ctx, inv, firstRow, lastRow);
             }
-            free(world);
-            return -1;
         }
+        PERF_THREAD_STOP(perfCounts);
+        PROFILE_THREAD_END();
+        if (population != NULL)
+        {
+            #pragma omp critical
+            addPopulation(population, &threadPopulation);
+        }
+    }
+    PROFILE_END(PHASE_KERNEL);
+
+    if (tally != NULL)
+    {
+        PROFILE_START(PHASE_REGIONS);
+        commitRegionTally(ctx->regions);
+        PROFILE_END(PHASE_REGIONS);
+    }
+
+    // swap worlds
+    PROFILE_START(PHASE_SWAP);
+    ctx->nextWorld = ctx->world;
+    ctx->world = wholeNewWorld;
+    int fd = ctx->nextWorldFd;
+    ctx->nextWorldFd = ctx->worldFd;
+    ctx->worldFd = fd;
+    PROFILE_END(PHASE_SWAP);
+    return deathToll;
+}
+
+/**
+ * Computes the next state of padded row row of ctx with rowKernel, a counting kernel, one tile at a time, and
+ * adds the population of each tile to the region tally. If population is not NULL the row's population is
+ * added to it as well. Returns the number of deaths due to fighting.
+ */
+static long nextRowByTile(const GoiContext *ctx, RowKernel rowKernel, long row, const int *inv, GoiPopulationStats *population,
+                          long *tally)
+{
+    long stride = ctx->stride;
+    int nCols = ctx->nCols;
+    int tileSize = ctx->regionTileSize;
+    const int *world = ctx->world;
+    long offset = row * stride + 1;
+    // rows sharing a tile may be computed by different threads
+    long *tiles = tally + (row - 1) / tileSize * regionTileCols(ctx->regions) * GOI_MAX_FACTIONS;
 
-        // get new states for each cell
-        // attempt 1: parallelise this part
-        int row;
-        int col;
-        #pragma omp parallel for shared(world, wholeNewWorld) private (row, col)
-        for (row = 0; row < nRows; row++)
+    long deaths = 0;
+    for (int col = 0; col < nCols; col += tileSize, tiles += GOI_MAX_FACTIONS)
+    {
+        int nTileCols = tileSize < nCols - col ? tileSize : nCols - col;
+        long at = offset + col;
+        // only the live counts are tallied unless population is wanted
+        GoiPopulationStats tile;
+        if (population != NULL)
         {
-            for (col = 0; col < nCols; col++)
+            memset(&tile, 0, sizeof(tile));
+        }
+        else
+        {
+            memset(tile.live, 0, sizeof(tile.live));
+        }
+        deaths += rowKernel(&ctx->rules, &ctx->live, world + at - stride, world + at, world + at + stride, inv != NULL ? inv + at : NULL,
+                            ctx->nextWorld + at, nTileCols, &tile);
+        for (int faction = 0; faction < MAX_FACTIONS; faction++)
+        {
+            if (tile.live[faction] != 0)
             {
-                bool diedDueToFighting;
-                int nextState = getNextState(world, inv, nRows, nCols, row, col, &diedDueToFighting);
-                setValueAt(wholeNewWorld, nRows, nCols, row, col, nextState);
-                if (diedDueToFighting)
-                {   
-                    // approach 2: create the critical section here
-                    // sem_wait(mutex);
-                    #pragma omp critical
-                    // printf("increase deathToll at iteration %i at row: %i and col: %i\n", i, row, col);
-                    deathToll++;
-                    // sem_post(mutex);
-                }
+                #pragma omp atomic
+                tiles[faction] += tile.live[faction];
             }
         }
+        if (population != NULL)
+        {
+            addPopulation(population, &tile);
+        }
+    }
+    return deaths;
+}
+
+/**
+ * Copies the opposite edges of the current world into its halo: the last row above the first, the first row
+ * below the last, and likewise for columns, corners included. A world one row or column thick wraps onto
+ * itself, so a cell counts itself as its neighbour across that edge, the same as indexing modulo the size.
+ */
+static void refreshHalo(GoiContext *ctx)
+{
+    int *world = ctx->world;
+    int nRows = ctx->nRows;
+    int nCols = ctx->nCols;
+    long stride = ctx->stride;
+
+    // columns first, for the interior rows...
+    for (int row = 1; row <= nRows; row++)
+    {
+        int *cells = world + row * stride;
+        cells[0] = cells[nCols];
+        cells[nCols + 1] = cells[1];
+    }
+
+    // ...then whole rows, which carries the corners along with them
+    memcpy(world, world + nRows * stride, sizeof(int) * stride);
+    memcpy(world + (nRows + 1) * stride, world + stride, sizeof(int) * stride);
+}
 
-        if (inv != NULL)
+/**
+ * Hints that padded rows firstRow to lastRow of the current world and invaders, clamped to the world, are
+ * about to be read by the kernel, along with the row below them.
+ */
+static void prefetchBand(const GoiContext *ctx, const int *invaders, long firstRow, long lastRow)
+{
+    if (firstRow > ctx->nRows)
+    {
+        return;
+    }
+    lastRow = lastRow < ctx->nRows ? lastRow : ctx->nRows;
+    long stride = ctx->stride;
+    prefetchCells(ctx->world + firstRow * stride, (lastRow - firstRow + 2) * stride);
+    if (invaders != NULL)
+    {
+        prefetchCells(invaders + firstRow * stride, (lastRow - firstRow + 1) * stride);
+    }
+}
+
+/**
+ * Called once padded rows firstRow to lastRow of the next world have been computed. Their writeback is
+ * started, and the source rows that no later band reads (all but lastRow, the next band's upper neighbour)
+ * are released, as are the invaders.
+ */
+static void retireBand(const GoiContext *ctx, const int *invaders, long firstRow, long lastRow)
+{
+    long stride = ctx->stride;
+    long nCells = (lastRow - firstRow + 1) * stride;
+    writeBackCells(ctx->nextWorldFd, ctx->nextWorld, ctx->nextWorld + firstRow * stride, nCells);
+    releaseCells(ctx->world + (firstRow - 1) * stride, nCells);
+    if (invaders != NULL)
+    {
+        releaseCells(invaders + firstRow * stride, nCells);
+    }
+}
+
+// addObserver registers observer, counting the population for it if population is set.
+static int addObserver(GoiContext *ctx, GoiObserver observer, int stride, void *userData, bool population)
+{
+    if (observer == NULL || stride <= 0 || ctx->nObservers == MAX_OBSERVERS)
+    {
+        return -1;
+    }
+    ctx->observers[ctx->nObservers].observer = observer;
+    ctx->observers[ctx->nObservers].stride = stride;
+    ctx->observers[ctx->nObservers].userData = userData;
+    ctx->observers[ctx->nObservers].population = population;
+    ctx->nObservers++;
+    return 0;
+}
+
+/**
+ * Returns the cleared population stats of ctx if a population observer is due after generation, or NULL.
+ */
+static GoiPopulationStats *startCounting(GoiContext *ctx, int generation)
+{
+    for (int i = 0; i < ctx->nObservers; i++)
+    {
+        if (ctx->observers[i].population && generation % ctx->observers[i].stride == 0)
         {
-            free(inv);
+            memset(&ctx->population, 0, sizeof(GoiPopulationStats));
+            return &ctx->population;
         }
+    }
+    return NULL;
+}
 
-        // swap worlds
-        free(world);
-        world = wholeNewWorld;
+/**
+ * Calls every observer whose stride divides the generation just completed. population is the generation's
+ * population if it was counted, or NULL.
+ */
+static void notifyObservers(GoiContext *ctx, long deaths, bool invaded, const GoiPopulationStats *population)
+{
+    GoiGenerationStats stats = {
+        .generation = ctx->generation,
+        .deaths = deaths,
+        .deathToll = ctx->deathToll,
+        .invaded = invaded,
+        .population = population,
+    };
+    const int *world = NULL;
+    for (int i = 0; i < ctx->nObservers; i++)
+    {
+        if (ctx->generation % ctx->observers[i].stride == 0)
+        {
+            if (world == NULL)
+            {
+                world = goi_world(ctx);
+            }
+            ctx->observers[i].observer(ctx, world, &stats, ctx->observers[i].userData);
+        }
+    }
+}
 
-#if PRINT_GENERATIONS
-        printf("\n=== WORLD %d ===\n", i);
-        printWorld(world, nRows, nCols);
-        printf("end of iteration %i\n", i);
+#if SAMPLE_PERF_COUNTERS
+// finishPerfWindow ends the run of ctx: the window it was partway through is reported, and the counters of
+// the threads that stepped it are closed, so that a long-lived process does not keep a group per thread open.
+static void finishPerfWindow(GoiContext *ctx)
+{
+    if (ctx->generation == 0)
+    {
+        // never stepped, so no counters were opened
+        return;
+    }
+    #pragma omp parallel num_threads(ctx->options.nThreads)
+    PERF_THREAD_FINISH();
+    if (ctx->generation >= ctx->perfWindowStart)
+    {
+        reportPerfWindow(ctx->perfCounts, ctx->perfWindowStart, ctx->generation, ctx->perfWindowSeconds);
+    }
+}
 #endif
 
-#if EXPORT_GENERATIONS
-        exportWorld(world, nRows, nCols);
-#endif
+/**
+ * The main simulation logic.
+ *
+ * goi does not own startWorld, invasionTimes or invasionPlans and should not modify or attempt to free them.
+ * nThreads is the number of threads to simulate with.
+ *
+ * This is a thin wrapper over a GoiContext with the default options.
+ */
+int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
+{
+    GoiOptions options;
+    goi_default_options(&options);
+    options.nThreads = nThreads;
+    GoiContext *ctx = goi_create(&options, startWorld, nRows, nCols, nInvasions, invasionTimes, invasionPlans);
+    if (ctx == NULL)
+    {
+        return -1;
     }
 
-    free(world);
+    goi_step(ctx, nGenerations);
+
+    int deathToll = (int) goi_death_toll(ctx);
+    goi_destroy(ctx);
     return deathToll;
 }
@@ -1,6 +1,175 @@
 #ifndef GOI_H
 #define GOI_H
 
+/**
+ * libgoi: the simulation as an embeddable library.
+ *
+ * A GoiContext holds one world and its invasion plan, and is advanced with goi_step. Nothing in the library
+ * reads or writes files or standard streams, other than the mapped engine's scratch files; the caller owns
+ * all I/O. Programs linking libgoi.a must also link with -fopenmp.
+ *
+ * Contexts are independent: different contexts may be used from different threads at the same time, but a
+ * single context must not be used from two threads at once.
+ */
+
+typedef struct GoiContext GoiContext;
+
+/**
+ * An ensemble advances up to GOI_ENSEMBLE_MAX_WORLDS worlds of the same size and rules in one pass, each
+ * world in its own lane of the same vector registers. The worlds may differ in their start and invasions.
+ */
+typedef struct GoiEnsemble GoiEnsemble;
+
+#define GOI_ENSEMBLE_MAX_WORLDS 32
+
+// factions a cell can be in, including the dead faction, 0
+#define GOI_MAX_FACTIONS 10
+
+typedef enum
+{
+    GOI_ENGINE_DENSE,  // the whole world as one row-major array, parallelised over rows
+    GOI_ENGINE_MAPPED, // as dense, but in memory-mapped scratch files swept in bands, for worlds larger than memory
+    GOI_ENGINE_SPARSE, // only the 64x64 chunks with live cells, in a hash table; for mostly dead worlds
+    GOI_ENGINE_RLE,    // each row as its runs of live cells; for worlds of long uniform runs and narrow active bands
+} GoiEngine;
+
+typedef enum
+{
+    GOI_TOPOLOGY_BOUNDED,   // cells beyond the edges are dead and nobody's neighbour
+    GOI_TOPOLOGY_TOROIDAL,  // the edges wrap around: the last row neighbours the first, as does the last column
+    GOI_TOPOLOGY_UNBOUNDED, // the edges are only a hint: life spreads past them (sparse engine only)
+} GoiTopology;
+
+typedef enum
+{
+    GOI_INVASION_OVERRIDE, // invaders replace whatever they land on; a live cell replaced dies due to fighting
+    GOI_INVASION_VACANT,   // invaders only land on dead cells; live cells follow the usual rules
+} GoiInvasionPolicy;
+
+/**
+ * The rules of the game. See goi_parse_rules for the text form.
+ */
+typedef struct
+{
+    unsigned birthMask;    // bit n set: a dead cell with exactly n neighbours of one faction is born into it
+    unsigned survivalMask; // bit n set: a live cell with exactly n friendly neighbours survives (unless it fights)
+    int fightThreshold;    // a live cell with at least this many hostile neighbours dies due to fighting
+    GoiInvasionPolicy invasionPolicy;
+} GoiRules;
+
+/**
+ * How the row kernels count the neighbours of each cell. All give the same results; the vector ones only run
+ * on CPUs with their instruction set (see goi_select_kernel).
+ */
+typedef enum
+{
+    GOI_KERNEL_AUTO,    // $GOI_KERNEL if set, else the fastest one this CPU supports
+    GOI_KERNEL_STENCIL, // the 9 cells around each cell, read afresh for every cell
+    GOI_KERNEL_WINDOW,  // a window sliding along the row, which sums each column of 3 cells only once
+    GOI_KERNEL_SWAR,    // 16 cells at a time, as the 4-bit lanes of 64-bit integers
+    GOI_KERNEL_SSE41,   // 4 cells at a time, as the 32-bit lanes of SSE4.1 registers
+    GOI_KERNEL_AVX2,    // 8 cells at a time, as the 32-bit lanes of AVX2 registers
+    GOI_KERNEL_AVX512,  // 16 cells at a time, as the 32-bit lanes of AVX-512 registers
+} GoiKernel;
+
+/**
+ * How the dense and mapped engines hand the rows of a generation out to their threads.
+ */
+typedef enum
+{
+    GOI_SCHEDULE_STATIC,  // one even share per thread, decided up front
+    GOI_SCHEDULE_DYNAMIC, // chunks handed to whichever thread is free
+    GOI_SCHEDULE_GUIDED,  // as dynamic, with the chunks shrinking towards the end
+} GoiSchedule;
+
+typedef struct
+{
+    int nThreads; // threads to simulate with; 0 or less means OpenMP's default
+    GoiEngine engine;
+    GoiTopology topology;
+    GoiRules rules;
+    GoiKernel kernel;
+    GoiSchedule schedule;
+    int chunkSize; // rows per chunk of the schedule; 0 or less means OpenMP's default
+    int tileCols;  // sweep the world in strips of this many columns, all rows of one after the other; 0 or less for whole rows
+} GoiOptions;
+
+/**
+ * What became of the cells during one generation, per faction. Every live cell that changed is counted
+ * once: a cell landed on by invaders counts as landed for the invaders, and as a fighting death for its old
+ * faction if it was alive, whatever the rules would have made of it. So for every live faction,
+ * live = previous live + births + landed - natural deaths - fighting deaths.
+ *
+ * live[0] counts the dead cells within the bounds, except under the unbounded topology, where it is 0.
+ */
+typedef struct
+{
+    long live[GOI_MAX_FACTIONS];           // cells of each faction once the generation is complete
+    long births[GOI_MAX_FACTIONS];         // dead cells born into each faction by the rules
+    long landed[GOI_MAX_FACTIONS];         // cells taken by invaders of each faction
+    long naturalDeaths[GOI_MAX_FACTIONS];  // cells of each faction that died of isolation or overcrowding
+    long fightingDeaths[GOI_MAX_FACTIONS]; // cells of each faction that died due to fighting or were landed on
+} GoiPopulationStats;
+
+/**
+ * What happened during one generation, as passed to observers.
+ */
+typedef struct
+{
+    int generation;  // the generation that was just completed
+    long deaths;     // deaths due to fighting during this generation
+    long deathToll;  // deaths due to fighting since generation 0
+    int invaded;     // non-zero if an invasion landed this generation
+    const GoiPopulationStats *population; // NULL unless a population observer is due this generation
+} GoiGenerationStats;
+
+/**
+ * Called after every stride-th generation with the just-completed world (goi_rows * goi_cols cells, read-only
+ * and only valid for the duration of the call) and that generation's stats. Observers run on the thread that
+ * called goi_step, between generations, and must not step or reset ctx.
+ */
+typedef void (*GoiObserver)(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData);
+
+void goi_default_options(GoiOptions *options);
+void goi_default_rules(GoiRules *rules);
+int goi_parse_rules(const char *spec, GoiRules *rules);
+int goi_parse_topology(const char *name, GoiTopology *topology);
+int goi_parse_engine(const char *name, GoiEngine *engine);
+int goi_parse_kernel(const char *name, GoiKernel *kernel);
+const char *goi_kernel_name(GoiKernel kernel);
+int goi_select_kernel(GoiKernel *kernel);
+int goi_parse_schedule(const char *name, GoiSchedule *schedule);
+const char *goi_schedule_name(GoiSchedule schedule);
+GoiContext *goi_create(const GoiOptions *options, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans);
+int goi_reset(GoiContext *ctx, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans);
+void goi_destroy(GoiContext *ctx);
+
+int goi_step(GoiContext *ctx, int nGenerations);
+
+int goi_add_observer(GoiContext *ctx, GoiObserver observer, int stride, void *userData);
+int goi_add_population_observer(GoiContext *ctx, GoiObserver observer, int stride, void *userData);
+
+int goi_enable_regions(GoiContext *ctx, int tileSize);
+int goi_region_tile_size(const GoiContext *ctx);
+int goi_region_population(const GoiContext *ctx, int tileRow, int tileCol, int nTileRows, int nTileCols,
+                          long counts[GOI_MAX_FACTIONS]);
+const long *goi_region_tiles(const GoiContext *ctx, int *nTileRows, int *nTileCols);
+void goi_clear_observers(GoiContext *ctx);
+
+const int *goi_world(GoiContext *ctx);
+const GoiOptions *goi_options(const GoiContext *ctx);
+int goi_rows(const GoiContext *ctx);
+int goi_cols(const GoiContext *ctx);
+int goi_generation(const GoiContext *ctx);
+long goi_death_toll(const GoiContext *ctx);
+
+GoiEnsemble *goi_ensemble_create(const GoiOptions *options, int nWorlds, int nRows, int nCols, int *const *startWorlds,
+                                 const int *nInvasions, int *const *invasionTimes, int **const *invasionPlans);
+void goi_ensemble_destroy(GoiEnsemble *ensemble);
+int goi_ensemble_step(GoiEnsemble *ensemble, int nGenerations);
+int goi_ensemble_size(const GoiEnsemble *ensemble);
+long goi_ensemble_death_toll(const GoiEnsemble *ensemble, int world);
+
 int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans);
 
 #endif
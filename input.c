@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "input.h"
+#include "util.h"
+#include "mapped.h"
+
+static int readParam(FILE *fp, char **line, size_t *len, int *param);
+static int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols);
+static int *allocLayout(const GoiInput *input);
+static void freeLayout(const GoiInput *input, int *layout);
+
+/**
+ * Parses a whole GOI input file from fp into input.
+ *
+ * Layouts are kept in file-backed scratch buffers if mapped is set, for worlds larger than memory.
+ *
+ * fp is read front to back, one line at a time and never seeking, so it may be a pipe. As the RULES line is
+ * optional, the input only ends with it or at the end of the stream.
+ *
+ * On error, a message naming the field that could not be read is written to stderr, everything allocated
+ * so far is released and -1 is returned. fp is not closed.
+ */
+int readInput(FILE *fp, GoiInput *input, bool mapped)
+{
+    char *line = NULL;
+    size_t len = 0;
+    const char *failedField = NULL;
+
+    memset(input, 0, sizeof(GoiInput));
+    input->mapped = mapped;
+
+    // Read nGenerations
+    if (readParam(fp, &line, &len, &input->nGenerations) == -1)
+    {
+        failedField = "N_GENERATIONS";
+        goto fail;
+    }
+
+    // Read nRows
+    if (readParam(fp, &line, &len, &input->nRows) == -1)
+    {
+        failedField = "N_ROWS";
+        goto fail;
+    }
+
+    // Read nCols
+    if (readParam(fp, &line, &len, &input->nCols) == -1)
+    {
+        failedField = "N_COLS";
+        goto fail;
+    }
+
+    if (input->nRows == 0 || input->nCols == 0)
+    {
+        fprintf(stderr, "N_ROWS or N_COLS is 0.\n");
+        goto fail;
+    }
+
+    // Read start world
+    input->startWorld = allocLayout(input);
+    if (input->startWorld == NULL || readWorldLayout(fp, &line, &len, input->startWorld, input->nRows, input->nCols) == -1)
+    {
+        failedField = "STARTING_WORLD";
+        goto fail;
+    }
+
+    // Read nInvasions
+    int nInvasions;
+    if (readParam(fp, &line, &len, &nInvasions) == -1)
+    {
+        failedField = "N_INVASIONS";
+        goto fail;
+    }
+
+    // Read invasions
+    input->invasionTimes = malloc(sizeof(int) * nInvasions);
+    input->invasionPlans = calloc(nInvasions, sizeof(int *));
+    if (input->invasionTimes == NULL || input->invasionPlans == NULL)
+    {
+        fprintf(stderr, "No memory for invasions.\n");
+        goto fail;
+    }
+    // plans are counted as they are allocated so that freeInput only walks the ones that exist
+    for (int i = 0; i < nInvasions; i++)
+    {
+        if (readParam(fp, &line, &len, input->invasionTimes + i))
+        {
+            failedField = "INVASION_TIME";
+            goto fail;
+        }
+
+        input->invasionPlans[i] = allocLayout(input);
+        input->nInvasions++;
+        if (input->invasionPlans[i] == NULL || readWorldLayout(fp, &line, &len, input->invasionPlans[i], input->nRows, input->nCols))
+        {
+            failedField = "INVASION_PLAN";
+            goto fail;
+        }
+    }
+
+    // Read the optional rules
+    if (getline(&line, &len, fp) != -1 && strncmp(line, "RULES", 5) == 0)
+    {
+        char *spec = line + 5;
+        spec += strspn(spec, " \t");
+        spec[strcspn(spec, " \t\r\n")] = '\0';
+        goi_default_rules(&input->rules);
+        if (goi_parse_rules(spec, &input->rules) == -1)
+        {
+            failedField = "RULES";
+            goto fail;
+        }
+        input->hasRules = true;
+    }
+
+    free(line);
+    return 0;
+
+fail:
+    if (failedField != NULL)
+    {
+        fprintf(stderr, "Failed to read %s.\n", failedField);
+    }
+    free(line);
+    freeInput(input);
+    return -1;
+}
+
+/**
+ * Reads only N_GENERATIONS, N_ROWS and N_COLS from the input file at path. This is cheap enough to do
+ * for thousands of files and lets callers size up work before committing memory to it.
+ *
+ * -1 is returned on error.
+ */
+int readInputHeader(const char *path, int *nGenerations, int *nRows, int *nCols)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    int ret = 0;
+    if (readParam(fp, &line, &len, nGenerations) == -1 ||
+        readParam(fp, &line, &len, nRows) == -1 ||
+        readParam(fp, &line, &len, nCols) == -1)
+    {
+        ret = -1;
+    }
+
+    free(line);
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * Releases everything owned by input. Safe to call on a partially read or already freed input.
+ */
+void freeInput(GoiInput *input)
+{
+    for (int i = 0; i < input->nInvasions; i++)
+    {
+        freeLayout(input, input->invasionPlans[i]);
+    }
+    free(input->invasionTimes);
+    free(input->invasionPlans);
+    freeLayout(input, input->startWorld);
+    memset(input, 0, sizeof(GoiInput));
+}
+
+/**
+ * Replaces the rules in options with the input's own, if it has any.
+ */
+void applyInputRules(const GoiInput *input, GoiOptions *options)
+{
+    if (input->hasRules)
+    {
+        options->rules = input->rules;
+    }
+}
+
+// readParam reads one integer from a line into param, advancing the read head to the next line.
+// -1 is returned on error.
+static int readParam(FILE *fp, char **line, size_t *len, int *param)
+{
+    if (getline(line, len, fp) == -1 ||
+        sscanf(*line, "%d", param) != 1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// allocLayout returns room for one nRows x nCols layout of input, or NULL if out of memory.
+static int *allocLayout(const GoiInput *input)
+{
+    long nCells = (long) input->nRows * input->nCols;
+    return input->mapped ? mapCells(nCells, NULL) : malloc(sizeof(int) * nCells);
+}
+
+// freeLayout releases a layout from allocLayout. NULL is ignored.
+static void freeLayout(const GoiInput *input, int *layout)
+{
+    if (input->mapped)
+    {
+        unmapCells(layout, (long) input->nRows * input->nCols, -1);
+    }
+    else
+    {
+        free(layout);
+    }
+}
+
+// readWorldLayout reads a world layout specified by nRows and nCols, advancing the read head by
+// nRows number of lines. -1 is returned on error.
+static int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols)
+{
+    for (int row = 0; row < nRows; row++)
+    {
+        if (getline(line, len, fp) == -1)
+        {
+            return -1;
+        }
+
+        char *p = *line;
+        for (int col = 0; col < nCols; col++)
+        {
+            char *end;
+            int cell = strtol(p, &end, 10);
+
+            // unexpected end
+            if (cell == 0 && end == p)
+            {
+                return -1;
+            }
+
+            // other errors
+            if (errno == EINVAL || errno == ERANGE)
+            {
+                return -1;
+            }
+
+            setValueAt(world, nRows, nCols, row, col, cell);
+            p = end;
+        }
+    }
+
+    return 0;
+}
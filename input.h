@@ -0,0 +1,35 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "goi.h"
+
+/**
+ * A fully parsed GOI input file. Every array is owned by the GoiInput and released by freeInput.
+ *
+ * An input file may end with an optional line "RULES <spec>" (see goi_parse_rules), in which case hasRules is
+ * set and rules holds the default rules with spec applied.
+ *
+ * A mapped input keeps its layouts in file-backed scratch buffers (see mapped.c) rather than on the heap.
+ */
+typedef struct
+{
+    int nGenerations;
+    int nRows;
+    int nCols;
+    int *startWorld;
+    int nInvasions;
+    int *invasionTimes;
+    int **invasionPlans;
+    bool hasRules;
+    GoiRules rules;
+    bool mapped;
+} GoiInput;
+
+int readInput(FILE *fp, GoiInput *input, bool mapped);
+int readInputHeader(const char *path, int *nGenerations, int *nRows, int *nCols);
+void freeInput(GoiInput *input);
+void applyInputRules(const GoiInput *input, GoiOptions *options);
+
+#endif
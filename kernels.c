@@ -0,0 +1,567 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "kernels.h"
+
+/**
+ * While counting, a row's tallies are kept in registers as one 6-bit lane per faction, like the neighbour
+ * counts, and emptied into the thread's GoiPopulationStats before a lane can overflow.
+ */
+#define TALLY_BITS 6
+#define TALLY_MASK 0x3f
+#define TALLY(faction) (1ULL << (TALLY_BITS * (faction)))
+#define TALLY_FLUSH_INTERVAL TALLY_MASK
+
+/**
+ * The SWAR ("SIMD within a register") kernels work on SWAR_CELLS cells at once, each in a 4-bit lane of a
+ * uint64_t, lane k holding cell k: the cells' factions, their neighbour counts (at most 8), or masks of all
+ * ones or all zeros per lane. Everything is plain 64-bit integer arithmetic, with no carries between lanes.
+ */
+#define SWAR_CELLS 16
+#define NIBBLES(value) (0x1111111111111111ULL * (uint64_t) (value))
+#define HIGH_BITS NIBBLES(0x8)
+
+/**
+ * The vector kernels are compiled for x86 instruction sets past the baseline through target attributes, so
+ * the one binary carries them all and picks among them at run time (see bestRowKernel). Elsewhere only the
+ * portable kernels exist.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_KERNELS 1
+#else
+#define VECTOR_KERNELS 0
+#endif
+#define PASTE(prefix, suffix) prefix##suffix
+#define EXPAND_PASTE(prefix, suffix) PASTE(prefix, suffix)
+#define VECTOR_NAME(name) EXPAND_PASTE(name, VECTOR_SUFFIX)
+
+static inline void flushTally(long *counts, uint64_t tally);
+static inline uint64_t packCells(const int *cells, int nCells);
+static inline uint64_t zeroLanes(uint64_t lanes);
+static inline uint64_t lanesEqual(uint64_t lanes, int value);
+static inline uint64_t lanesIn(uint64_t lanes, unsigned counts);
+static inline uint64_t lanesAtLeast(uint64_t lanes, int value);
+static inline long countLanes(uint64_t mask);
+
+/**
+ * Computes the next state of one row of nCols cells into next. above, row and below point at the first cell
+ * of the row and of its neighbouring rows, each readable one cell beyond either end. invaders is the matching
+ * row of the invasion plan, or NULL if there are no invaders.
+ *
+ * This is the one source of every row kernel: it is always inlined into a wrapper that fixes nLive, the
+ * number of live factions it is specialised for, so that the branches on nLive fold away. With one or two
+ * live factions only those are counted, by comparison; beyond that every faction is counted at once in
+ * packed lanes and births are resolved through the candidate table.
+ *
+ * The wrapper also fixes mode, what becomes of every cell that is added to population, which belongs to the
+ * calling thread: with COUNT_LIVE the faction it ends up in (dead cells included), with COUNT_ALL also how it
+ * got there if it changed. With COUNT_NOTHING population is never touched and the tallies compile away.
+ *
+ * Last, it fixes whether neighbours are counted over a sliding window (GOI_KERNEL_WINDOW) instead of from
+ * the 9 cells around each cell. The window keeps the packed counts of the three columns of three cells
+ * around the cell, each column summed once, as it enters on the right; moving one cell on adds the column
+ * entering and subtracts the one leaving, so every cell is read 3 times rather than 9.
+ *
+ * Returns the number of cells in the row that died due to fighting.
+ */
+static inline __attribute__((always_inline)) long nextRowFor(const RuleTable *rules, const LiveFactions *live, const int *above,
+                                                             const int *row, const int *below, const int *invaders, int *next,
+                                                             int nCols, GoiPopulationStats *population, int nLive, CountMode mode,
+                                                             bool window)
+{
+    int firstFaction = live->factions[0];
+    int secondFaction = nLive == 2 ? live->factions[1] : DEAD_FACTION;
+    long deaths = 0;
+    uint64_t leftColumn = 0;
+    uint64_t middleColumn = 0;
+    uint64_t windowCounts = 0;
+    if (window)
+    {
+        leftColumn = ONE_HOT(above[-1]) + ONE_HOT(row[-1]) + ONE_HOT(below[-1]);
+        middleColumn = ONE_HOT(above[0]) + ONE_HOT(row[0]) + ONE_HOT(below[0]);
+        windowCounts = leftColumn + middleColumn;
+    }
+    uint64_t liveTally = 0;
+    uint64_t birthTally = 0;
+    uint64_t landedTally = 0;
+    uint64_t naturalTally = 0;
+    uint64_t fightingTally = 0;
+    for (int col = 0; col < nCols; col++)
+    {
+        int cellFaction = row[col];
+        int friendly;
+        int hostile;
+        int born;
+
+        uint64_t counts = 0;
+        if (window)
+        {
+            // slide the window onto the cell: its right column enters; the left one leaves once it is done
+            uint64_t rightColumn = ONE_HOT(above[col + 1]) + ONE_HOT(row[col + 1]) + ONE_HOT(below[col + 1]);
+            windowCounts += rightColumn;
+            counts = windowCounts - ONE_HOT(cellFaction);
+            windowCounts -= leftColumn;
+            leftColumn = middleColumn;
+            middleColumn = rightColumn;
+        }
+
+        if (nLive <= 2 && window)
+        {
+            int firstCount = LANE(counts, firstFaction);
+            int secondCount = nLive == 2 ? LANE(counts, secondFaction) : 0;
+            friendly = cellFaction == firstFaction ? firstCount : (nLive == 2 && cellFaction == secondFaction ? secondCount : 0);
+            hostile = firstCount + secondCount - friendly;
+            born = rules->birthable[firstCount] ? firstFaction : DEAD_FACTION;
+            if (nLive == 2)
+            {
+                born = rules->birthable[secondCount] ? secondFaction : born;
+            }
+        }
+        else if (nLive <= 2)
+        {
+            // count neighbours (and self) of just the live factions
+            int firstCount = 0;
+            int secondCount = 0;
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                firstCount += (above[col + dx] == firstFaction) + (row[col + dx] == firstFaction) + (below[col + dx] == firstFaction);
+                if (nLive == 2)
+                {
+                    secondCount += (above[col + dx] == secondFaction) + (row[col + dx] == secondFaction) + (below[col + dx] == secondFaction);
+                }
+            }
+
+            // we counted this cell as its "neighbor"; adjust for this
+            firstCount -= cellFaction == firstFaction;
+            secondCount -= nLive == 2 && cellFaction == secondFaction;
+
+            friendly = cellFaction == firstFaction ? firstCount : (nLive == 2 && cellFaction == secondFaction ? secondCount : 0);
+            hostile = firstCount + secondCount - friendly;
+
+            // factions are in ascending order, so the second one wins a tie, as the highest faction always has
+            born = rules->birthable[firstCount] ? firstFaction : DEAD_FACTION;
+            if (nLive == 2)
+            {
+                born = rules->birthable[secondCount] ? secondFaction : born;
+            }
+        }
+        else
+        {
+            if (!window)
+            {
+                // count neighbours (and self), every faction at once
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    counts += ONE_HOT(above[col + dx]) + ONE_HOT(row[col + dx]) + ONE_HOT(below[col + dx]);
+                }
+
+                // we counted this cell as its "neighbor"; adjust for this
+                counts -= ONE_HOT(cellFaction);
+            }
+
+            friendly = LANE(counts, cellFaction) & -(cellFaction != DEAD_FACTION);
+            hostile = MAX_NEIGHBORS - LANE(counts, DEAD_FACTION) - friendly;
+
+            // a dead cell can be born into any faction with a birthable count; the highest one wins
+            unsigned candidates = 0;
+            for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+            {
+                candidates |= (unsigned) rules->birthable[LANE(counts, faction)] << faction;
+            }
+            born = rules->birthFaction[candidates];
+        }
+
+        // a live cell looks up its fate by friendly and hostile counts; a dead cell has friendly forced to 0
+        // and lands in the all-dead plane of the table
+        int liveNext = rules->liveNext[cellFaction][friendly][hostile];
+        int nextState = (liveNext & ~FIGHT_FLAG) | (born & -(cellFaction == DEAD_FACTION));
+        bool diedDueToFighting = (liveNext & FIGHT_FLAG) != 0;
+
+        // did someone just get landed on? the value is overriden by the invasion at this position
+        bool landed = invaders != NULL && invaders[col] != DEAD_FACTION &&
+                      (rules->invasionPolicy == GOI_INVASION_OVERRIDE || cellFaction == DEAD_FACTION);
+        if (landed)
+        {
+            diedDueToFighting = cellFaction != DEAD_FACTION;
+            nextState = invaders[col];
+        }
+
+        next[col] = nextState;
+        deaths += diedDueToFighting;
+
+        if (mode != COUNT_NOTHING)
+        {
+            liveTally += TALLY(nextState);
+            // most cells stay as they were
+            if (mode == COUNT_ALL && (nextState != cellFaction || landed))
+            {
+                if (landed)
+                {
+                    landedTally += TALLY(nextState);
+                    fightingTally += (uint64_t) diedDueToFighting << (TALLY_BITS * cellFaction);
+                }
+                else if (cellFaction == DEAD_FACTION)
+                {
+                    birthTally += TALLY(nextState);
+                }
+                else if (diedDueToFighting)
+                {
+                    fightingTally += TALLY(cellFaction);
+                }
+                else
+                {
+                    naturalTally += TALLY(cellFaction);
+                }
+            }
+
+            if ((col + 1) % TALLY_FLUSH_INTERVAL == 0 || col == nCols - 1)
+            {
+                flushTally(population->live, liveTally);
+                if (mode == COUNT_ALL)
+                {
+                    flushTally(population->births, birthTally);
+                    flushTally(population->landed, landedTally);
+                    flushTally(population->naturalDeaths, naturalTally);
+                    flushTally(population->fightingDeaths, fightingTally);
+                }
+                liveTally = birthTally = landedTally = naturalTally = fightingTally = 0;
+            }
+        }
+    }
+    return deaths;
+}
+
+/**
+ * Computes one row like nextRowFor, with the same arguments and results, SWAR_CELLS cells at a time.
+ *
+ * For each live faction, the cells of the three rows that are of it become lanes of 1s, which add up into
+ * column counts, and the column counts shifted one lane either way, plus the columns just outside, into
+ * neighbour counts. The rules are then applied to all the lanes at once through masks: a cell fights if its
+ * hostile count (all live neighbours less friendly ones) reaches the threshold, survives if its friendly
+ * count is in the survival set, and, if dead, is born into the highest faction whose count is in the birth
+ * set. Only packing the rows into lanes and the result out of them goes cell by cell.
+ *
+ * nLive and mode are fixed by the wrapper as for nextRowFor; with more than two live factions the loop over
+ * them is not unrolled.
+ */
+static inline __attribute__((always_inline)) long nextRowSwarFor(const RuleTable *rules, const LiveFactions *live, const int *above,
+                                                                 const int *row, const int *below, const int *invaders, int *next,
+                                                                 int nCols, GoiPopulationStats *population, int nLive, CountMode mode)
+{
+    int nFactions = nLive <= 2 ? nLive : live->nFactions;
+    long deaths = 0;
+    for (int col = 0; col < nCols; col += SWAR_CELLS)
+    {
+        // a short last block has dead lanes past its end, which are masked off where it matters
+        int nCells = nCols - col < SWAR_CELLS ? nCols - col : SWAR_CELLS;
+        uint64_t inBlock = nCells == SWAR_CELLS ? ~0ULL : (1ULL << (4 * nCells)) - 1;
+        uint64_t up = packCells(above + col, nCells);
+        uint64_t cells = packCells(row + col, nCells);
+        uint64_t down = packCells(below + col, nCells);
+        uint64_t alive = ~zeroLanes(cells) & inBlock;
+
+        uint64_t counts[MAX_FACTIONS - 1];
+        uint64_t total = 0;
+        uint64_t friendly = 0;
+        for (int i = 0; i < nFactions; i++)
+        {
+            int faction = live->factions[i];
+            uint64_t own = lanesEqual(cells, faction);
+            uint64_t column = (lanesEqual(up, faction) & NIBBLES(1)) + (own & NIBBLES(1)) + (lanesEqual(down, faction) & NIBBLES(1));
+            uint64_t leftColumn = (above[col - 1] == faction) + (row[col - 1] == faction) + (below[col - 1] == faction);
+            uint64_t rightColumn = (above[col + nCells] == faction) + (row[col + nCells] == faction) + (below[col + nCells] == faction);
+            // 9 at most before the cell itself is taken off, so lanes never carry
+            uint64_t count = column + (column << 4 | leftColumn) + (column >> 4 | rightColumn << (4 * (nCells - 1))) - (own & NIBBLES(1));
+            counts[i] = count & inBlock;
+            total += counts[i];
+            friendly |= counts[i] & own;
+        }
+
+        uint64_t fought = alive & lanesAtLeast(total - friendly, rules->fightThreshold);
+        uint64_t survives = alive & ~fought & lanesIn(friendly, rules->survivalCounts);
+        uint64_t nextCells = cells & survives;
+        uint64_t vacant = inBlock & ~alive;
+        for (int i = 0; i < nFactions; i++)
+        {
+            // factions are in ascending order, so the highest birthable one is written last and wins
+            uint64_t born = vacant & lanesIn(counts[i], rules->birthCounts);
+            nextCells = (nextCells & ~born) | (NIBBLES(live->factions[i]) & born);
+        }
+
+        uint64_t landed = 0;
+        if (invaders != NULL)
+        {
+            uint64_t invading = packCells(invaders + col, nCells);
+            landed = ~zeroLanes(invading) & (rules->invasionPolicy == GOI_INVASION_OVERRIDE ? alive | vacant : vacant);
+            nextCells = (nextCells & ~landed) | (invading & landed);
+            fought = (fought & ~landed) | (landed & alive);
+        }
+
+        for (int k = 0; k < nCells; k++)
+        {
+            next[col + k] = (int) (nextCells >> (4 * k)) & 0xf;
+        }
+        deaths += countLanes(fought);
+
+        if (mode != COUNT_NOTHING)
+        {
+            long nLiveCells = 0;
+            for (int i = 0; i < nFactions; i++)
+            {
+                int faction = live->factions[i];
+                uint64_t becomes = lanesEqual(nextCells, faction) & inBlock;
+                long nBecome = countLanes(becomes);
+                population->live[faction] += nBecome;
+                nLiveCells += nBecome;
+                if (mode == COUNT_ALL)
+                {
+                    uint64_t was = lanesEqual(cells, faction) & alive;
+                    population->births[faction] += countLanes(becomes & vacant & ~landed);
+                    population->landed[faction] += countLanes(becomes & landed);
+                    population->fightingDeaths[faction] += countLanes(was & fought);
+                    population->naturalDeaths[faction] += countLanes(was & ~fought & ~landed & ~survives);
+                }
+            }
+            population->live[DEAD_FACTION] += nCells - nLiveCells;
+        }
+    }
+    return deaths;
+}
+
+// every row kernel is nextRowFor or nextRowSwarFor with its specialisation fixed
+#define ROW_KERNEL(name, template, ...)                                                                                            \
+    static long name(const RuleTable *rules, const LiveFactions *live, const int *above, const int *row, const int *below,         \
+                     const int *invaders, int *next, int nCols, GoiPopulationStats *population)                                    \
+    {                                                                                                                              \
+        return template(rules, live, above, row, below, invaders, next, nCols, population, __VA_ARGS__);                           \
+    }
+
+// Classic Life, a single live faction which never has a hostile neighbour; two live factions; any number
+ROW_KERNEL(nextRowSingle, nextRowFor, 1, COUNT_NOTHING, false)
+ROW_KERNEL(nextRowPair, nextRowFor, 2, COUNT_NOTHING, false)
+ROW_KERNEL(nextRowGeneral, nextRowFor, MAX_FACTIONS - 1, COUNT_NOTHING, false)
+
+// the counting counterparts of the kernels above, for the generations whose population is observed or
+// while the region index is kept
+ROW_KERNEL(nextRowSingleLive, nextRowFor, 1, COUNT_LIVE, false)
+ROW_KERNEL(nextRowPairLive, nextRowFor, 2, COUNT_LIVE, false)
+ROW_KERNEL(nextRowGeneralLive, nextRowFor, MAX_FACTIONS - 1, COUNT_LIVE, false)
+ROW_KERNEL(nextRowSingleCounting, nextRowFor, 1, COUNT_ALL, false)
+ROW_KERNEL(nextRowPairCounting, nextRowFor, 2, COUNT_ALL, false)
+ROW_KERNEL(nextRowGeneralCounting, nextRowFor, MAX_FACTIONS - 1, COUNT_ALL, false)
+
+// and all of the above over a sliding window
+ROW_KERNEL(nextRowSingleWindow, nextRowFor, 1, COUNT_NOTHING, true)
+ROW_KERNEL(nextRowPairWindow, nextRowFor, 2, COUNT_NOTHING, true)
+ROW_KERNEL(nextRowGeneralWindow, nextRowFor, MAX_FACTIONS - 1, COUNT_NOTHING, true)
+ROW_KERNEL(nextRowSingleLiveWindow, nextRowFor, 1, COUNT_LIVE, true)
+ROW_KERNEL(nextRowPairLiveWindow, nextRowFor, 2, COUNT_LIVE, true)
+ROW_KERNEL(nextRowGeneralLiveWindow, nextRowFor, MAX_FACTIONS - 1, COUNT_LIVE, true)
+ROW_KERNEL(nextRowSingleCountingWindow, nextRowFor, 1, COUNT_ALL, true)
+ROW_KERNEL(nextRowPairCountingWindow, nextRowFor, 2, COUNT_ALL, true)
+ROW_KERNEL(nextRowGeneralCountingWindow, nextRowFor, MAX_FACTIONS - 1, COUNT_ALL, true)
+
+// and in SWAR lanes
+ROW_KERNEL(nextRowSingleSwar, nextRowSwarFor, 1, COUNT_NOTHING)
+ROW_KERNEL(nextRowPairSwar, nextRowSwarFor, 2, COUNT_NOTHING)
+ROW_KERNEL(nextRowGeneralSwar, nextRowSwarFor, MAX_FACTIONS - 1, COUNT_NOTHING)
+ROW_KERNEL(nextRowSingleLiveSwar, nextRowSwarFor, 1, COUNT_LIVE)
+ROW_KERNEL(nextRowPairLiveSwar, nextRowSwarFor, 2, COUNT_LIVE)
+ROW_KERNEL(nextRowGeneralLiveSwar, nextRowSwarFor, MAX_FACTIONS - 1, COUNT_LIVE)
+ROW_KERNEL(nextRowSingleCountingSwar, nextRowSwarFor, 1, COUNT_ALL)
+ROW_KERNEL(nextRowPairCountingSwar, nextRowSwarFor, 2, COUNT_ALL)
+ROW_KERNEL(nextRowGeneralCountingSwar, nextRowSwarFor, MAX_FACTIONS - 1, COUNT_ALL)
+
+// and in the lanes of each instruction set's vectors
+#if VECTOR_KERNELS
+#define VECTOR_SUFFIX Sse41
+#define VECTOR_TARGET "sse4.1"
+#define VECTOR_LANES 4
+#include "vectorkernel.h"
+
+#define VECTOR_SUFFIX Avx2
+#define VECTOR_TARGET "avx2"
+#define VECTOR_LANES 8
+#include "vectorkernel.h"
+
+#define VECTOR_SUFFIX Avx512
+#define VECTOR_TARGET "avx512f"
+#define VECTOR_LANES 16
+#include "vectorkernel.h"
+#endif
+
+/**
+ * Returns the row kernel of the kind given, specialised for the live factions, that tallies what mode asks
+ * for. A world with none uses the single-faction kernel, which never sees a live cell.
+ */
+RowKernel selectRowKernel(const LiveFactions *live, CountMode mode, GoiKernel kind)
+{
+    static const RowKernel kernels[][3][3] = {
+        [GOI_KERNEL_STENCIL] =
+            {
+                [COUNT_NOTHING] = {nextRowSingle, nextRowPair, nextRowGeneral},
+                [COUNT_LIVE] = {nextRowSingleLive, nextRowPairLive, nextRowGeneralLive},
+                [COUNT_ALL] = {nextRowSingleCounting, nextRowPairCounting, nextRowGeneralCounting},
+            },
+        [GOI_KERNEL_WINDOW] =
+            {
+                [COUNT_NOTHING] = {nextRowSingleWindow, nextRowPairWindow, nextRowGeneralWindow},
+                [COUNT_LIVE] = {nextRowSingleLiveWindow, nextRowPairLiveWindow, nextRowGeneralLiveWindow},
+                [COUNT_ALL] = {nextRowSingleCountingWindow, nextRowPairCountingWindow, nextRowGeneralCountingWindow},
+            },
+        [GOI_KERNEL_SWAR] =
+            {
+                [COUNT_NOTHING] = {nextRowSingleSwar, nextRowPairSwar, nextRowGeneralSwar},
+                [COUNT_LIVE] = {nextRowSingleLiveSwar, nextRowPairLiveSwar, nextRowGeneralLiveSwar},
+                [COUNT_ALL] = {nextRowSingleCountingSwar, nextRowPairCountingSwar, nextRowGeneralCountingSwar},
+            },
+#if VECTOR_KERNELS
+        [GOI_KERNEL_SSE41] =
+            {
+                [COUNT_NOTHING] = {nextRowSingleSse41, nextRowPairSse41, nextRowGeneralSse41},
+                [COUNT_LIVE] = {nextRowSingleLiveSse41, nextRowPairLiveSse41, nextRowGeneralLiveSse41},
+                [COUNT_ALL] = {nextRowSingleCountingSse41, nextRowPairCountingSse41, nextRowGeneralCountingSse41},
+            },
+        [GOI_KERNEL_AVX2] =
+            {
+                [COUNT_NOTHING] = {nextRowSingleAvx2, nextRowPairAvx2, nextRowGeneralAvx2},
+                [COUNT_LIVE] = {nextRowSingleLiveAvx2, nextRowPairLiveAvx2, nextRowGeneralLiveAvx2},
+                [COUNT_ALL] = {nextRowSingleCountingAvx2, nextRowPairCountingAvx2, nextRowGeneralCountingAvx2},
+            },
+        [GOI_KERNEL_AVX512] =
+            {
+                [COUNT_NOTHING] = {nextRowSingleAvx512, nextRowPairAvx512, nextRowGeneralAvx512},
+                [COUNT_LIVE] = {nextRowSingleLiveAvx512, nextRowPairLiveAvx512, nextRowGeneralLiveAvx512},
+                [COUNT_ALL] = {nextRowSingleCountingAvx512, nextRowPairCountingAvx512, nextRowGeneralCountingAvx512},
+            },
+#endif
+    };
+    return kernels[kind][mode][live->nFactions <= 1 ? 0 : (live->nFactions == 2 ? 1 : 2)];
+}
+
+/**
+ * Returns whether the CPU can run the row kernels of the kind given. GOI_KERNEL_AUTO is not a kind of its own.
+ */
+bool rowKernelSupported(GoiKernel kind)
+{
+    switch (kind)
+    {
+    case GOI_KERNEL_STENCIL:
+    case GOI_KERNEL_WINDOW:
+    case GOI_KERNEL_SWAR:
+        return true;
+#if VECTOR_KERNELS
+    case GOI_KERNEL_SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case GOI_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case GOI_KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * Returns the fastest kind of row kernel that the CPU can run: the first supported one of the registry of
+ * kinds below, which is ordered by their speed on 1000x1000 worlds. The 4 lanes of SSE4.1 lose to the 16 of
+ * SWAR, so it is only ever run when asked for.
+ */
+GoiKernel bestRowKernel(void)
+{
+    static const GoiKernel registry[] = {GOI_KERNEL_AVX512, GOI_KERNEL_AVX2, GOI_KERNEL_SWAR};
+    for (size_t i = 0; i < sizeof(registry) / sizeof(registry[0]); i++)
+    {
+        if (rowKernelSupported(registry[i]))
+        {
+            return registry[i];
+        }
+    }
+    return GOI_KERNEL_STENCIL;
+}
+
+// flushTally adds the lanes of tally to counts, one per faction.
+static inline void flushTally(long *counts, uint64_t tally)
+{
+    for (int faction = 0; faction < MAX_FACTIONS; faction++)
+    {
+        counts[faction] += (tally >> (TALLY_BITS * faction)) & TALLY_MASK;
+    }
+}
+
+// packCells packs the nCells (at most SWAR_CELLS) cells from cells into lanes; the lanes past them are dead.
+static inline uint64_t packCells(const int *cells, int nCells)
+{
+    uint64_t lanes = 0;
+    for (int k = 0; k < nCells; k++)
+    {
+        lanes |= (uint64_t) cells[k] << (4 * k);
+    }
+    return lanes;
+}
+
+// zeroLanes returns all ones in the lanes that are 0, and 0 in the others.
+static inline uint64_t zeroLanes(uint64_t lanes)
+{
+    // the top bit of each lane is set if any of its bits is, without carrying out of the lane
+    uint64_t nonZero = (((lanes & ~HIGH_BITS) + ~HIGH_BITS) | lanes) & HIGH_BITS;
+    return ((nonZero ^ HIGH_BITS) >> 3) * 0xf;
+}
+
+// lanesEqual returns all ones in the lanes equal to value, and 0 in the others.
+static inline uint64_t lanesEqual(uint64_t lanes, int value)
+{
+    return zeroLanes(lanes ^ NIBBLES(value));
+}
+
+// lanesIn returns all ones in the lanes whose count (at most MAX_NEIGHBORS) has its bit set in counts.
+static inline uint64_t lanesIn(uint64_t lanes, unsigned counts)
+{
+    uint64_t in = 0;
+    for (int count = 0; count <= MAX_NEIGHBORS; count++)
+    {
+        if (counts & (1u << count))
+        {
+            in |= lanesEqual(lanes, count);
+        }
+    }
+    return in;
+}
+
+// lanesAtLeast returns all ones in the lanes whose count (at most MAX_NEIGHBORS) is at least value.
+static inline uint64_t lanesAtLeast(uint64_t lanes, int value)
+{
+    if (value > MAX_NEIGHBORS)
+    {
+        return 0;
+    }
+    if (value <= 0)
+    {
+        return ~0ULL;
+    }
+    // a count of value or more reaches the top bit of its lane, and at most 15 never leaves it
+    return (((lanes + NIBBLES(MAX_NEIGHBORS - value)) & HIGH_BITS) >> 3) * 0xf;
+}
+
+// countLanes returns how many lanes are set in mask, whose lanes are all ones or all zeros.
+static inline long countLanes(uint64_t mask)
+{
+    return __builtin_popcountll(mask & NIBBLES(1));
+}
+
+/**
+ * Adds the counts of part, such as one thread's tally, to total.
+ */
+void addPopulation(GoiPopulationStats *total, const GoiPopulationStats *part)
+{
+    for (int faction = 0; faction < MAX_FACTIONS; faction++)
+    {
+        total->live[faction] += part->live[faction];
+        total->births[faction] += part->births[faction];
+        total->landed[faction] += part->landed[faction];
+        total->naturalDeaths[faction] += part->naturalDeaths[faction];
+        total->fightingDeaths[faction] += part->fightingDeaths[faction];
+    }
+}
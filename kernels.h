@@ -0,0 +1,35 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdbool.h>
+#include "rules.h"
+
+/**
+ * The factions that can ever be alive in a simulation: those in the start world or in any invasion plan.
+ * Birth needs live neighbours and survival needs a live cell, so no other faction can ever appear.
+ */
+typedef struct
+{
+    int nFactions;
+    int factions[MAX_FACTIONS - 1]; // in ascending order
+} LiveFactions;
+
+/**
+ * What a row kernel tallies into the GoiPopulationStats it is given.
+ */
+typedef enum
+{
+    COUNT_NOTHING,
+    COUNT_LIVE, // only live, the faction each cell ends up in
+    COUNT_ALL,  // live, and how each cell that changed got there
+} CountMode;
+
+typedef long (*RowKernel)(const RuleTable *rules, const LiveFactions *live, const int *above, const int *row, const int *below,
+                          const int *invaders, int *next, int nCols, GoiPopulationStats *population);
+
+RowKernel selectRowKernel(const LiveFactions *live, CountMode mode, GoiKernel kind);
+bool rowKernelSupported(GoiKernel kind);
+GoiKernel bestRowKernel(void);
+void addPopulation(GoiPopulationStats *total, const GoiPopulationStats *part);
+
+#endif
@@ -12,183 +12,528 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <errno.h>
-#include <time.h>
+#include <getopt.h>
 #include <omp.h>
 #include "util.h"
 #include "exporter.h"
 #include "settings.h"
 #include "goi.h"
+#include "input.h"
+#include "batch.h"
+#include "bench.h"
+#include "profile.h"
+#include "population.h"
+#include "tune.h"
+#include "daemon.h"
 
-int readParam(FILE *fp, char **line, size_t *len, int *param);
-int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols);
+static void printUsage(const char *program);
+#if PRINT_GENERATIONS
+static void printGeneration(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData);
+#endif
+#if EXPORT_GENERATIONS
+static void exportGeneration(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData);
+#endif
+static void recordPopulation(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData);
+static int parseThreads(const char *arg, int *nThreads);
+static int parseThreadList(const char *arg, int **threadCounts, int *nThreadCounts);
+static int parseCount(const char *name, const char *arg, int min, int *count);
 
 /**
  * Handles input, output and file open/close operations. Delegates simulation to goi.
  */
 int main(int argc, char *argv[])
 {
-    int nGenerations;
-    int nRows;
-    int nCols;
-    int *startWorld;
-    int nInvasions;
-    int *invasionTimes;
-    int **invasionPlans;
+    const char *manifestPath = NULL;
+    const char *socketPath = NULL;
+    const char *framesPath = NULL;
+#if EXPORT_GENERATIONS
+    bool exportBinary = false;
+#endif
+    bool ensemble = false;
+    bool benchmark = false;
+    BenchOptions benchOptions = {
+        .nWarmups = 1,
+        .nRepetitions = 5,
+        .csvPath = NULL,
+    };
+    const char *statsPath = NULL;
+    int statsStride = 1;
+    bool statsBinary = false;
+    const char *regionsPath = NULL;
+    int regionTileSize = 64;
+    int regionStride = 1;
+    bool tune = false;
+    const char *tuneCache = defaultTuningCache();
+    bool scheduleGiven = false;
+    bool chunkGiven = false;
+    bool tileGiven = false;
+    GoiOptions options;
+    bool fixedRules = false;
     int nThreads;
+    GoiInput input;
 
-    // FILE *analysisFile;
     FILE *outputFile;
     FILE *inputFile;
-    char *line = NULL;
-    size_t len = 0;
 
-    if (argc < 4)
+    PROFILE_INIT();
+    goi_default_options(&options);
+
+    static const struct option longOptions[] = {
+        {"batch", required_argument, NULL, 'b'},
+        {"ensemble", no_argument, NULL, 'E'},
+        {"bench", no_argument, NULL, 'B'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"reps", required_argument, NULL, 'r'},
+        {"csv", required_argument, NULL, 'c'},
+        {"rules", required_argument, NULL, 'R'},
+        {"topology", required_argument, NULL, 't'},
+        {"engine", required_argument, NULL, 'e'},
+        {"stats", required_argument, NULL, 's'},
+        {"stats-stride", required_argument, NULL, 'S'},
+        {"stats-binary", no_argument, NULL, 'y'},
+        {"regions", required_argument, NULL, 'g'},
+        {"region-tile", required_argument, NULL, 'T'},
+        {"region-stride", required_argument, NULL, 'G'},
+        {"kernel", required_argument, NULL, 'k'},
+        {"schedule", required_argument, NULL, 'H'},
+        {"chunk", required_argument, NULL, 'K'},
+        {"tile", required_argument, NULL, 'L'},
+        {"tune", no_argument, NULL, 'U'},
+        {"tune-cache", required_argument, NULL, 'C'},
+        {"serve", required_argument, NULL, 'D'},
+#if EXPORT_GENERATIONS
+        {"export-binary", no_argument, NULL, 'X'},
+#endif
+        {"frames-to-json", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, NULL)) != -1)
     {
+        switch (opt)
+        {
+        case 'b':
+            manifestPath = optarg;
+            break;
+        case 'E':
+            ensemble = true;
+            break;
+        case 'B':
+            benchmark = true;
+            break;
+        case 'w':
+            if (parseCount("--warmup", optarg, 0, &benchOptions.nWarmups) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'r':
+            if (parseCount("--reps", optarg, 1, &benchOptions.nRepetitions) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            benchOptions.csvPath = optarg;
+            break;
+        case 'R':
+            if (goi_parse_rules(optarg, &options.rules) == -1)
+            {
+                fprintf(stderr, "Failed to parse --rules '%s'. Aborting...\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            fixedRules = true;
+            break;
+        case 'e':
+            if (goi_parse_engine(optarg, &options.engine) == -1)
+            {
+                fprintf(stderr, "Unknown --engine '%s'. Aborting...\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 't':
+            if (goi_parse_topology(optarg, &options.topology) == -1)
+            {
+                fprintf(stderr, "Unknown --topology '%s'. Aborting...\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            statsPath = optarg;
+            break;
+        case 'S':
+            if (parseCount("--stats-stride", optarg, 1, &statsStride) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'y':
+            statsBinary = true;
+            break;
+        case 'g':
+            regionsPath = optarg;
+            break;
+        case 'T':
+            if (parseCount("--region-tile", optarg, 1, &regionTileSize) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'G':
+            if (parseCount("--region-stride", optarg, 1, &regionStride) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'k':
+            if (goi_parse_kernel(optarg, &options.kernel) == -1)
+            {
+                fprintf(stderr, "Unknown --kernel '%s'. Aborting...\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'H':
+            if (goi_parse_schedule(optarg, &options.schedule) == -1)
+            {
+                fprintf(stderr, "Unknown --schedule '%s'. Aborting...\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            scheduleGiven = true;
+            break;
+        case 'K':
+            if (parseCount("--chunk", optarg, 1, &options.chunkSize) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            chunkGiven = true;
+            break;
+        case 'L':
+            if (parseCount("--tile", optarg, 1, &options.tileCols) == -1)
+            {
+                exit(EXIT_FAILURE);
+            }
+            tileGiven = true;
+            break;
+        case 'U':
+            tune = true;
+            break;
+        case 'C':
+            tuneCache = optarg;
+            break;
+        case 'D':
+            socketPath = optarg;
+            break;
 #if EXPORT_GENERATIONS
-        fprintf(stderr, "Usage: %s <INPUT_PATH> <OUTPUT_PATH> <NUM_THREADS> [<OPT_EXPORT_PATH>]\n", argv[0]);
-#else
-        fprintf(stderr, "Usage: %s <INPUT_PATH> <OUTPUT_PATH> <NUM_THREADS>\n", argv[0]);
+        case 'X':
+            exportBinary = true;
+            break;
 #endif
+        case 'J':
+            framesPath = optarg;
+            break;
+        default:
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // from here on, args only holds the positional arguments
+    char **args = argv + optind;
+    int nArgs = argc - optind;
+
+    if (manifestPath != NULL)
+    {
+        if (nArgs < 1)
+        {
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        printf("<MANIFEST_PATH>: %s\n", manifestPath);
+        printf("<NUM_THREADS>: %s\n", args[0]);
+        if (parseThreads(args[0], &nThreads) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        options.nThreads = nThreads;
+        int nFailed = ensemble ? runEnsembleBatch(manifestPath, &options, fixedRules) : runBatch(manifestPath, &options, fixedRules);
+        exit(nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (framesPath != NULL)
+    {
+        // the JSON goes to stdout unless a path is given
+        FILE *framesFile = fopen(framesPath, "rb");
+        FILE *jsonFile = nArgs < 1 || strcmp(args[0], "-") == 0 ? stdout : fopen(args[0], "w");
+        if (framesFile == NULL || jsonFile == NULL)
+        {
+            fprintf(stderr, "Failed to open %s. Aborting...\n", framesFile == NULL ? framesPath : args[0]);
+            exit(EXIT_FAILURE);
+        }
+        int ret = convertFramesToJson(framesFile, jsonFile);
+        fclose(framesFile);
+        ret |= fclose(jsonFile) == EOF ? -1 : 0;
+        exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (socketPath != NULL)
+    {
+        if (nArgs < 1)
+        {
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        printf("<SOCKET_PATH>: %s\n", socketPath);
+        printf("<NUM_THREADS>: %s\n", args[0]);
+        if (parseThreads(args[0], &nThreads) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+        const char *kernelName = options.kernel == GOI_KERNEL_AUTO ? getenv("GOI_KERNEL") : goi_kernel_name(options.kernel);
+        if (goi_select_kernel(&options.kernel) == -1)
+        {
+            fprintf(stderr, "Kernel '%s' is unknown or needs an instruction set this CPU lacks. Aborting...\n", kernelName);
+            exit(EXIT_FAILURE);
+        }
+        printf("Row kernel: %s\n", goi_kernel_name(options.kernel));
+
+        options.nThreads = nThreads;
+        int ret = runDaemon(socketPath, &options, fixedRules);
+        exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (benchmark)
+    {
+        if (nArgs < 2)
+        {
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        int *threadCounts;
+        if (parseThreadList(args[1], &threadCounts, &benchOptions.nThreadCounts) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+        benchOptions.threadCounts = threadCounts;
+        benchOptions.simulation = options;
+        benchOptions.fixedRules = fixedRules;
+
+        int ret = runBenchmark(args[0], &benchOptions);
+        free(threadCounts);
+        exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (tune)
+    {
+        if (nArgs < 1)
+        {
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        int maxThreads = omp_get_num_procs();
+        if (nArgs >= 2 && parseThreads(args[1], &maxThreads) == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+        int ret = runTuner(args[0], &options, fixedRules, maxThreads, tuneCache);
+        exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (nArgs < 3)
+    {
+        printUsage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    printf("<INPUT_PATH>: %s\n", argv[1]);
-    printf("<OUTPUT_PATH>: %s\n", argv[2]);
-    printf("<NUM_THREADS>: %s\n", argv[3]);
-    // analysisFile = fopen("analysisFile.out", "a");
+    // "-" reads the input from stdin or writes the death toll to stdout, so that the simulator can sit in a
+    // pipeline; stdout then carries nothing but the death toll, and the status lines go to stderr
+    bool readStdin = strcmp(args[0], "-") == 0;
+    bool writeStdout = strcmp(args[1], "-") == 0;
+    FILE *status = writeStdout ? stderr : stdout;
+
+    fprintf(status, "<INPUT_PATH>: %s\n", args[0]);
+    fprintf(status, "<OUTPUT_PATH>: %s\n", args[1]);
+    fprintf(status, "<NUM_THREADS>: %s\n", args[2]);
 #if EXPORT_GENERATIONS
     FILE *exportFile = NULL;
-    if (argc >= 5)
+    if (nArgs >= 4)
     {
-        printf("<OPT_EXPORT_PATH>: %s\n", argv[4]);
-        exportFile = fopen(argv[4], "w");
-        initWorldExporter(exportFile);
+        fprintf(status, "<OPT_EXPORT_PATH>: %s\n", args[3]);
+        exportFile = fopen(args[3], exportBinary ? "wb" : "w");
+        // binary frames start with the world's dimensions, so their exporter starts once the input is read
+        if (!exportBinary)
+        {
+            initWorldExporter(exportFile);
+        }
     }
 #endif
-    clock_t start = clock();
-    inputFile = fopen(argv[1], "r");
+    inputFile = readStdin ? stdin : fopen(args[0], "r");
     if (inputFile == NULL)
     {
-        fprintf(stderr, "Failed to open %s for reading. Aborting...\n", argv[1]);
+        fprintf(stderr, "Failed to open %s for reading. Aborting...\n", args[0]);
         exit(EXIT_FAILURE);
     }
 
-    outputFile = fopen(argv[2], "w");
+    outputFile = writeStdout ? stdout : fopen(args[1], "w");
     if (outputFile == NULL)
     {
-        fprintf(stderr, "Failed to open %s for writing. Aborting...\n", argv[2]);
+        fprintf(stderr, "Failed to open %s for writing. Aborting...\n", args[1]);
         exit(EXIT_FAILURE);
     }
 
-    // Parse nThreads
-    if (sscanf(argv[3], "%d", &nThreads) != 1 )
+    // Parse nThreads; "auto" leaves it to the tuning cache
+    bool autoThreads = strcmp(args[2], "auto") == 0;
+    if (!autoThreads && parseThreads(args[2], &nThreads) == -1)
     {
-        fprintf(stderr, "Failed to parse <NUM_THREADS> as positive integer. Got '%s'. Aborting...\n", argv[3]);
         exit(EXIT_FAILURE);
     }
-    if (nThreads < 1)
+
+    // Read the whole input; readInput reports which part of it was malformed
+    PROFILE_START(PHASE_PARSE);
+    if (readInput(inputFile, &input, options.engine == GOI_ENGINE_MAPPED) == -1)
     {
-        fprintf(stderr, "<NUM_THREADS> has invalid value: %d. Aborting...\n", nThreads);
+        fprintf(stderr, "Failed to parse %s. Aborting...\n", args[0]);
         exit(EXIT_FAILURE);
     }
+    PROFILE_END(PHASE_PARSE);
 
-    // Read nGenerations
-    if (readParam(inputFile, &line, &len, &nGenerations) == -1)
+#if PRINT_GENERATIONS
+    printf("N_GENERATIONS: %d, N_ROWS: %d, N_COLS: %d, N_INVASIONS: %d\n", input.nGenerations, input.nRows, input.nCols, input.nInvasions);
+    printf("\n== STARTING_WORLD ==\n");
+    printWorld(input.startWorld, input.nRows, input.nCols);
+    for (int i = 0; i < input.nInvasions; i++)
     {
-        fprintf(stderr, "Failed to read N_GENERATIONS. Aborting...\n");
-        exit(EXIT_FAILURE);
+        printf("\n== invasion %d at time: %d ==\n", i, input.invasionTimes[i]);
+        printWorld(input.invasionPlans[i], input.nRows, input.nCols);
     }
+#endif
 
-    // Read nRows
-    if (readParam(inputFile, &line, &len, &nRows) == -1)
+    // we're done with the file
+    fclose(inputFile);
+#if EXPORT_GENERATIONS
+    if (exportBinary && exportFile != NULL && initBinaryWorldExporter(exportFile, input.nRows, input.nCols) == -1)
     {
-        fprintf(stderr, "Failed to read N_ROWS. Aborting...\n");
         exit(EXIT_FAILURE);
     }
+#endif
 
-    // Read nCols
-    if (readParam(inputFile, &line, &len, &nCols) == -1)
+    // a configuration tuned for worlds of this size on this CPU fills in whatever was not given
+    Tuning tuning;
+    if (tuneCache != NULL && loadTuning(tuneCache, input.nRows, input.nCols, &tuning) == 0)
     {
-        fprintf(stderr, "Failed to read N_COLS. Aborting...\n");
-        exit(EXIT_FAILURE);
+        fprintf(status, "Applying the tuning for %d x %d worlds from %s\n", input.nRows, input.nCols, tuneCache);
+        nThreads = autoThreads ? tuning.nThreads : nThreads;
+        options.schedule = scheduleGiven ? options.schedule : tuning.schedule;
+        options.chunkSize = chunkGiven ? options.chunkSize : tuning.chunkSize;
+        options.tileCols = tileGiven ? options.tileCols : tuning.tileCols;
     }
-
-    if (nRows == 0 || nCols == 0)
+    else if (autoThreads)
     {
-        fprintf(stderr, "N_ROWS or N_COLS is 0. Aborting...\n");
-        exit(EXIT_FAILURE);
+        nThreads = omp_get_max_threads();
     }
 
-    // Read start world
-    startWorld = malloc(sizeof(int) * nRows * nCols);
-    if (startWorld == NULL || readWorldLayout(inputFile, &line, &len, startWorld, nRows, nCols) == -1)
+    #pragma omp parallel num_threads(nThreads)
     {
-        fprintf(stderr, "Failed to read STARTING_WORLD. Aborting...\n");
-        exit(EXIT_FAILURE);
+        #pragma omp single
+        fprintf(status, "Number of threads used for parallel: %i\n", omp_get_num_threads());
     }
 
-    // Read nInvasions
-    if (readParam(inputFile, &line, &len, &nInvasions) == -1)
+    // pick the row kernel for this CPU up front, so that one it cannot run is reported as such
+    const char *kernelName = options.kernel == GOI_KERNEL_AUTO ? getenv("GOI_KERNEL") : goi_kernel_name(options.kernel);
+    if (goi_select_kernel(&options.kernel) == -1)
     {
-        fprintf(stderr, "Failed to read N_INVASIONS. Aborting...\n");
+        fprintf(stderr, "Kernel '%s' is unknown or needs an instruction set this CPU lacks. Aborting...\n", kernelName);
         exit(EXIT_FAILURE);
     }
+    fprintf(status, "Row kernel: %s\n", goi_kernel_name(options.kernel));
 
-    // Read invasions
-    invasionTimes = malloc(sizeof(int) * nInvasions);
-    invasionPlans = malloc(sizeof(int *) * nInvasions);
-    if (invasionTimes == NULL || invasionPlans == NULL)
+    // run the simulation; rules given on the command line win over the input's own
+    options.nThreads = nThreads;
+#if EXPORT_GENERATIONS
+    setWorldExporterThreads(nThreads);
+#endif
+    if (!fixedRules)
     {
-        fprintf(stderr, "No memory for invasions. Aborting...\n");
+        applyInputRules(&input, &options);
+    }
+    GoiContext *ctx = goi_create(&options, input.startWorld, input.nRows, input.nCols, input.nInvasions, input.invasionTimes, input.invasionPlans);
+    if (ctx == NULL)
+    {
+        fprintf(stderr, "Failed to simulate %s. Aborting...\n", args[0]);
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < nInvasions; i++)
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+    // observers only see completed generations, so generation 0 is handled here
+    GoiGenerationStats start = {0};
+#endif
+#if PRINT_GENERATIONS
+    printGeneration(ctx, goi_world(ctx), &start, NULL);
+    goi_add_observer(ctx, printGeneration, 1, NULL);
+#endif
+#if EXPORT_GENERATIONS
+    exportGeneration(ctx, goi_world(ctx), &start, NULL);
+    goi_add_observer(ctx, exportGeneration, 1, NULL);
+#endif
+
+    // the population series also starts from generation 0, whose population is counted here
+    PopulationWriter populationWriter = {NULL, false};
+    if (statsPath != NULL)
     {
-        if (invasionTimes == NULL || readParam(inputFile, &line, &len, invasionTimes + i))
+        GoiPopulationStats population;
+        const int *world = goi_world(ctx);
+        if (world == NULL || openPopulationWriter(&populationWriter, statsPath, statsBinary) == -1)
         {
-            fprintf(stderr, "Failed to read INVASION_TIME. Aborting...\n");
             exit(EXIT_FAILURE);
         }
+        countPopulation(world, (long) input.nRows * input.nCols, &population);
+        writePopulation(&populationWriter, 0, &population);
+        goi_add_population_observer(ctx, recordPopulation, statsStride, &populationWriter);
+    }
 
-        invasionPlans[i] = malloc(sizeof(int) * nRows * nCols);
-        if (invasionPlans[i] == NULL || readWorldLayout(inputFile, &line, &len, invasionPlans[i], nRows, nCols))
+    // the region index is dumped between runs of generations rather than by an observer, which would be
+    // handed a copy of the world that nobody reads
+    FILE *regionsFile = NULL;
+    if (regionsPath != NULL)
+    {
+        if (goi_enable_regions(ctx, regionTileSize) == -1)
+        {
+            fprintf(stderr, "Failed to index the regions of %s (the sparse and rle engines have no region index). Aborting...\n", args[0]);
+            exit(EXIT_FAILURE);
+        }
+        regionsFile = openRegionDump(regionsPath, ctx);
+        if (regionsFile == NULL)
         {
-            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
             exit(EXIT_FAILURE);
         }
+        writeRegionDump(regionsFile, ctx);
+        for (int left = input.nGenerations; left >= regionStride; left -= regionStride)
+        {
+            goi_step(ctx, regionStride);
+            writeRegionDump(regionsFile, ctx);
+        }
     }
 
-#if PRINT_GENERATIONS
-    printf("N_GENERATIONS: %d, N_ROWS: %d, N_COLS: %d, N_INVASIONS: %d\n", nGenerations, nRows, nCols, nInvasions);
-    printf("\n== STARTING_WORLD ==\n");
-    printWorld(startWorld, nRows, nCols);
-    for (int i = 0; i < nInvasions; i++)
+    goi_step(ctx, input.nGenerations - goi_generation(ctx));
+    long warDeathToll = goi_death_toll(ctx);
+    goi_destroy(ctx);
+
+    // output the result
+    PROFILE_START(PHASE_OUTPUT);
+    fprintf(outputFile, "%ld", warDeathToll);
+    fclose(outputFile);
+    if (closePopulationWriter(&populationWriter) == -1)
     {
-        printf("\n== invasion %d at time: %d ==\n", i, invasionTimes[i]);
-        printWorld(invasionPlans[i], nRows, nCols);
+        fprintf(stderr, "Failed to write %s.\n", statsPath);
     }
-#endif
-
-    // we're done with the file
-    fclose(inputFile);
-    if (line)
+    if (regionsFile != NULL && (ferror(regionsFile) | fclose(regionsFile)) != 0)
     {
-        free(line);
+        fprintf(stderr, "Failed to write %s.\n", regionsPath);
     }
-
-    // run the simulation
-    int warDeathToll = goi(nThreads, nGenerations, startWorld, nRows, nCols, nInvasions, invasionTimes, invasionPlans);
-
-    clock_t end = clock();
-    double time_spent = (double) (end - start) / CLOCKS_PER_SEC;
-    double time_spent_total = time_spent / nThreads;
-    
-    // output the result
-    fprintf(outputFile, "%d", warDeathToll);
-    fclose(outputFile);
-
-    // fprintf(analysisFile, "%s with %s threads took %f\n", argv[1], argv[3], time_spent_total);
-    // fclose(analysisFile);
+    PROFILE_END(PHASE_OUTPUT);
 
 #if EXPORT_GENERATIONS
     if (exportFile != NULL)
@@ -198,60 +543,143 @@ int main(int argc, char *argv[])
 #endif
 
     // free everything!
-    for (int i = 0; i < nInvasions; i++)
-    {
-        free(invasionPlans[i]);
-    }
-    free(invasionTimes);
-    free(invasionPlans);
-    free(startWorld);
+    freeInput(&input);
+}
+
+#if PRINT_GENERATIONS
+static void printGeneration(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData)
+{
+    printf("\n=== WORLD %d ===\n", stats->generation);
+    printWorld(world, goi_rows(ctx), goi_cols(ctx));
+}
+#endif
+
+#if EXPORT_GENERATIONS
+static void exportGeneration(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData)
+{
+    PROFILE_START(PHASE_EXPORT);
+    exportFrame(world, goi_rows(ctx), goi_cols(ctx), stats->generation, stats->deathToll);
+    PROFILE_END(PHASE_EXPORT);
+}
+#endif
+
+// recordPopulation appends the population of each generation it sees to the PopulationWriter in userData.
+static void recordPopulation(const GoiContext *ctx, const int *world, const GoiGenerationStats *stats, void *userData)
+{
+    writePopulation(userData, stats->generation, stats->population);
+}
+
+static void printUsage(const char *program)
+{
+#if EXPORT_GENERATIONS
+    fprintf(stderr, "Usage: %s [<OPTIONS>] <INPUT_PATH> <OUTPUT_PATH> <NUM_THREADS> [<OPT_EXPORT_PATH>]\n", program);
+#else
+    fprintf(stderr, "Usage: %s [<OPTIONS>] <INPUT_PATH> <OUTPUT_PATH> <NUM_THREADS>\n", program);
+#endif
+    fprintf(stderr, "       %s [<OPTIONS>] --batch <MANIFEST_PATH> [--ensemble] <NUM_THREADS>\n", program);
+    fprintf(stderr, "       %s [<OPTIONS>] --bench [--warmup N] [--reps N] [--csv <CSV_PATH>] <INPUT_PATH> <NUM_THREADS>[,<NUM_THREADS>...]\n", program);
+    fprintf(stderr, "       %s [<OPTIONS>] --tune <INPUT_PATH> [<MAX_THREADS>]\n", program);
+    fprintf(stderr, "       %s [<OPTIONS>] --serve <SOCKET_PATH> <NUM_THREADS>\n", program);
+    fprintf(stderr, "       %s --frames-to-json <FRAMES_PATH> [<JSON_PATH>]\n", program);
+    fprintf(stderr, "<NUM_THREADS> may be auto, for the tuned thread count or else OpenMP's default.\n");
+    fprintf(stderr, "<INPUT_PATH> and <OUTPUT_PATH> may be -, for stdin and stdout; the status lines then go to stderr.\n");
+    fprintf(stderr, "--serve keeps a daemon up that simulates the inputs submitted on a Unix socket by goi-client.out.\n");
+    fprintf(stderr, "--frames-to-json converts frames exported with --export-binary into the visualizer's JSON.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --rules <SPEC>                     rules to play by, e.g. B3/S23/F1/Ioverride, instead of the input's own\n");
+    fprintf(stderr, "  --topology bounded|toroidal|unbounded\n");
+    fprintf(stderr, "                                     whether the world's edges are walls (default), wrap around, or are\n");
+    fprintf(stderr, "                                     only a hint; unbounded needs the sparse engine, toroidal a dense one\n");
+    fprintf(stderr, "  --engine dense|mapped|sparse|rle   keep worlds in memory, in scratch files under $GOI_SCRATCH_DIR, as\n");
+    fprintf(stderr, "                                     the 64x64 chunks that have live cells, or as runs of cells per row\n");
+    fprintf(stderr, "  --kernel stencil|window|swar|sse4.1|avx2|avx512\n");
+    fprintf(stderr, "                                     count each cell's neighbours afresh, over a window sliding along the\n");
+    fprintf(stderr, "                                     row that reads each cell 3 times instead of 9, for 16 cells at once in\n");
+    fprintf(stderr, "                                     the 4-bit lanes of 64-bit integers, or in vector registers; by default\n");
+    fprintf(stderr, "                                     $GOI_KERNEL, or else the fastest one this CPU supports\n");
+    fprintf(stderr, "  --ensemble                         in a batch, advance up to %d jobs of the same size and rules together,\n", GOI_ENSEMBLE_MAX_WORLDS);
+    fprintf(stderr, "                                     one per vector lane\n");
+    fprintf(stderr, "  --stats <PATH>                     write the population of each faction, births and deaths to a CSV\n");
+    fprintf(stderr, "  --stats-stride N                   only every Nth generation (and generation 0) (default: 1)\n");
+    fprintf(stderr, "  --stats-binary                     write the series as compact binary records instead of CSV\n");
+    fprintf(stderr, "  --regions <PATH>                   keep a region index and dump the population of each tile to a binary\n");
+    fprintf(stderr, "                                     file at generation 0 and every --region-stride N generations (default: 1)\n");
+    fprintf(stderr, "  --region-tile N                    the tile size of the region index, in cells (default: 64)\n");
+    fprintf(stderr, "  --schedule static|dynamic|guided   how rows are shared out among threads (default: static)\n");
+    fprintf(stderr, "  --chunk N                          rows per chunk of the schedule (default: OpenMP's)\n");
+    fprintf(stderr, "  --tile N                           sweep the world in strips of N columns (default: whole rows)\n");
+#if EXPORT_GENERATIONS
+    fprintf(stderr, "  --export-binary                    export packed 4-bit binary frames instead of JSON\n");
+#endif
+    fprintf(stderr, "  --tune-cache <PATH>                where --tune saves the best configuration for a world size and CPU, and\n");
+    fprintf(stderr, "                                     where runs look it up (default: $GOI_TUNE_CACHE, or ~/.goi-tuning)\n");
 }
 
-// readParam reads one integer from a line into param, advancing the read head to the next line.
-// -1 is returned on error.
-int readParam(FILE *fp, char **line, size_t *len, int *param)
+// parseThreads parses a <NUM_THREADS> argument into nThreads.
+// -1 is returned, and the reason written to stderr, if it is not a positive integer.
+static int parseThreads(const char *arg, int *nThreads)
 {
-    if (getline(line, len, fp) == -1 ||
-        sscanf(*line, "%d", param) != 1)
+    if (sscanf(arg, "%d", nThreads) != 1)
+    {
+        fprintf(stderr, "Failed to parse <NUM_THREADS> as positive integer. Got '%s'. Aborting...\n", arg);
+        return -1;
+    }
+    if (*nThreads < 1)
     {
+        fprintf(stderr, "<NUM_THREADS> has invalid value: %d. Aborting...\n", *nThreads);
         return -1;
     }
     return 0;
 }
 
-// readWorldLayout reads a world layout specified by nRows and nCols, advancing the read head by
-// nRows number of lines. -1 is returned on error.
-int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols)
+// parseThreadList parses a comma-separated list of <NUM_THREADS> values into a newly allocated array.
+// -1 is returned, and the reason written to stderr, if any of them is not a positive integer.
+static int parseThreadList(const char *arg, int **threadCounts, int *nThreadCounts)
 {
-    for (int row = 0; row < nRows; row++)
+    int capacity = 1;
+    for (const char *p = arg; *p != '\0'; p++)
+    {
+        capacity += *p == ',';
+    }
+
+    *threadCounts = malloc(sizeof(int) * capacity);
+    if (*threadCounts == NULL)
+    {
+        fprintf(stderr, "No memory for thread counts. Aborting...\n");
+        return -1;
+    }
+
+    *nThreadCounts = 0;
+    const char *p = arg;
+    while (true)
     {
-        if (getline(line, len, fp) == -1)
+        if (parseThreads(p, *threadCounts + *nThreadCounts) == -1)
         {
+            free(*threadCounts);
             return -1;
         }
+        (*nThreadCounts)++;
 
-        char *p = *line;
-        for (int col = 0; col < nCols; col++)
+        p = strchr(p, ',');
+        if (p == NULL)
         {
-            char *end;
-            int cell = strtol(p, &end, 10);
-
-            // unexpected end
-            if (cell == 0 && end == p)
-            {
-                return -1;
-            }
-
-            // other errors
-            if (errno == EINVAL || errno == ERANGE)
-            {
-                return -1;
-            }
-
-            setValueAt(world, nRows, nCols, row, col, cell);
-            p = end;
+            return 0;
         }
+        p++;
     }
+}
 
+// parseCount parses the integer argument of the option called name into count.
+// -1 is returned, and the reason written to stderr, if it is not an integer of at least min.
+static int parseCount(const char *name, const char *arg, int min, int *count)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || value < min || value > 1000000000)
+    {
+        fprintf(stderr, "%s expects an integer of at least %d. Got '%s'. Aborting...\n", name, min, arg);
+        return -1;
+    }
+    *count = (int) value;
     return 0;
 }
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "mapped.h"
+
+/**
+ * File-backed cell buffers for worlds larger than memory. Each buffer lives in a scratch file that is unlinked
+ * as soon as it is created, so it disappears with the process however it exits. The kernel, not the caller,
+ * decides which pages stay resident, guided by the hints below.
+ *
+ * Scratch files go in $GOI_SCRATCH_DIR, else $TMPDIR, else /tmp. That directory should be on a real disk:
+ * a tmpfs is backed by memory and swap, which defeats the purpose.
+ */
+
+static const char *scratchDirectory(void);
+static void pageRange(const int *cells, long nCells, bool inner, uintptr_t *start, size_t *length);
+
+/**
+ * Maps a new zero-filled buffer of nCells cells. If fd is not NULL it receives the scratch file's descriptor,
+ * which must be passed to unmapCells; otherwise the descriptor is closed straight away.
+ *
+ * NULL is returned if the file could not be created, sized or mapped.
+ */
+int *mapCells(long nCells, int *fd)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/goi-XXXXXX", scratchDirectory()) >= (int) sizeof(path))
+    {
+        return NULL;
+    }
+
+    int file = mkstemp(path);
+    if (file == -1)
+    {
+        return NULL;
+    }
+    unlink(path);
+
+    size_t length = sizeof(int) * (size_t) nCells;
+    void *cells = MAP_FAILED;
+    if (ftruncate(file, length) == 0)
+    {
+        cells = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    if (cells == MAP_FAILED)
+    {
+        close(file);
+        return NULL;
+    }
+
+    // the kernels sweep every buffer front to back, so read ahead aggressively and drop pages behind
+    madvise(cells, length, MADV_SEQUENTIAL);
+
+    if (fd != NULL)
+    {
+        *fd = file;
+    }
+    else
+    {
+        close(file);
+    }
+    return cells;
+}
+
+/**
+ * Unmaps a buffer from mapCells and closes its descriptor, if it kept one (fd is -1 otherwise). The scratch
+ * file goes away with its last reference.
+ */
+void unmapCells(int *cells, long nCells, int fd)
+{
+    if (cells != NULL)
+    {
+        munmap(cells, sizeof(int) * (size_t) nCells);
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+/**
+ * Hints that nCells cells from cells are about to be read, so that they are paged in ahead of the kernel.
+ */
+void prefetchCells(const int *cells, long nCells)
+{
+    uintptr_t start;
+    size_t length;
+    pageRange(cells, nCells, false, &start, &length);
+    if (length > 0)
+    {
+        madvise((void *) start, length, MADV_WILLNEED);
+    }
+}
+
+/**
+ * Starts writing back nCells cells from cells, which have just been written, without waiting for it to
+ * finish. base is the start of the mapping of fd. Dirty pages are otherwise only flushed under memory
+ * pressure, all at once and by whichever thread faults next.
+ */
+void writeBackCells(int fd, const int *base, const int *cells, long nCells)
+{
+    uintptr_t start;
+    size_t length;
+    pageRange(cells, nCells, false, &start, &length);
+    if (length > 0)
+    {
+        sync_file_range(fd, start - (uintptr_t) base, length, SYNC_FILE_RANGE_WRITE);
+    }
+}
+
+/**
+ * Hints that nCells cells from cells will not be needed for a while. The mapping is shared, so nothing is
+ * lost: the pages go back to the page cache and are read in again when next touched. Only pages that lie
+ * wholly inside the range are released.
+ */
+void releaseCells(const int *cells, long nCells)
+{
+    uintptr_t start;
+    size_t length;
+    pageRange(cells, nCells, true, &start, &length);
+    if (length > 0)
+    {
+        madvise((void *) start, length, MADV_DONTNEED);
+    }
+}
+
+// scratchDirectory returns the directory that scratch files are created in.
+static const char *scratchDirectory(void)
+{
+    const char *dir = getenv("GOI_SCRATCH_DIR");
+    if (dir == NULL || *dir == '\0')
+    {
+        dir = getenv("TMPDIR");
+    }
+    return dir != NULL && *dir != '\0' ? dir : "/tmp";
+}
+
+// pageRange rounds the byte range of nCells cells from cells to whole pages, outwards, or inwards if inner.
+static void pageRange(const int *cells, long nCells, bool inner, uintptr_t *start, size_t *length)
+{
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t) cells;
+    uintptr_t last = first + sizeof(int) * (size_t) nCells;
+    if (inner)
+    {
+        first = (first + pageSize - 1) & ~(pageSize - 1);
+        last &= ~(pageSize - 1);
+    }
+    else
+    {
+        first &= ~(pageSize - 1);
+        last = (last + pageSize - 1) & ~(pageSize - 1);
+    }
+    *start = first;
+    *length = last > first ? last - first : 0;
+}
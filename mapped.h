@@ -0,0 +1,12 @@
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <stdbool.h>
+
+int *mapCells(long nCells, int *fd);
+void unmapCells(int *cells, long nCells, int fd);
+void prefetchCells(const int *cells, long nCells);
+void writeBackCells(int fd, const int *base, const int *cells, long nCells);
+void releaseCells(const int *cells, long nCells);
+
+#endif
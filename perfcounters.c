@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "perfcounters.h"
+
+#if SAMPLE_PERF_COUNTERS
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define DEFAULT_PERF_WINDOW 100
+
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// bytes moved from memory per last-level cache miss, used for the bandwidth estimate
+#define CACHE_LINE_SIZE 64
+
+typedef enum
+{
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    N_COUNTERS
+} PerfCounter;
+
+static const struct
+{
+    const char *name;
+    unsigned int type;
+    unsigned long long config;
+} counterSpecs[N_COUNTERS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"LLC misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {"dTLB misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+// a group read: the number of counters, the times the group was enabled and actually counting (less than
+// enabled while the kernel multiplexes it with other groups), then one value per counter in opening order
+typedef struct
+{
+    unsigned long long nCounters;
+    unsigned long long timeEnabled;
+    unsigned long long timeRunning;
+    unsigned long long values[N_COUNTERS];
+} GroupRead;
+
+// the counts of one thread of a context's team in the open window
+typedef struct
+{
+    unsigned long long values[N_COUNTERS];
+    bool valid[N_COUNTERS];
+    bool sampled;
+    bool scaled; // some counts were estimated from a multiplexed group
+    char padding[26];
+} ThreadCounts;
+
+struct PerfCounts
+{
+    int nThreads;
+    ThreadCounts threads[];
+};
+
+// counters opened with pid 0 only count the thread that opened them, so their descriptors are thread-local:
+// -2 means not opened yet, -1 means no counter could be opened on this thread
+static __thread int leaderFd = -2;
+// descriptor of each counter, -1 if it could not be opened
+static __thread int counterFds[N_COUNTERS];
+// position of each counter in a group read, -1 if it could not be opened
+static __thread int counterIndex[N_COUNTERS];
+static __thread int nOpened;
+// the group as read by startPerfCounters, valid if started is set
+static __thread GroupRead startRead;
+static __thread bool started;
+
+static bool warned = false;
+
+static void openPerfCounters(void);
+
+/**
+ * Returns the number of generations per reporting window, as set by GOI_PERF_WINDOW.
+ */
+int getPerfWindow(void)
+{
+    const char *value = getenv("GOI_PERF_WINDOW");
+    int window = value != NULL ? atoi(value) : 0;
+    return window > 0 ? window : DEFAULT_PERF_WINDOW;
+}
+
+/**
+ * Returns empty window counts for a team of nThreads threads, or NULL if out of memory. Each simulation context
+ * has its own, so that contexts stepped at the same time, as in a packed batch, keep their counts apart.
+ */
+PerfCounts *createPerfCounts(int nThreads)
+{
+    PerfCounts *counts = calloc(1, sizeof(PerfCounts) + sizeof(ThreadCounts) * nThreads);
+    if (counts != NULL)
+    {
+        counts->nThreads = nThreads;
+    }
+    return counts;
+}
+
+/**
+ * Frees counts. Does nothing if counts is NULL.
+ */
+void freePerfCounts(PerfCounts *counts)
+{
+    free(counts);
+}
+
+/**
+ * Starts counting on the calling thread, opening its counters on first use.
+ */
+void startPerfCounters(void)
+{
+    if (leaderFd == -2)
+    {
+        openPerfCounters();
+    }
+    started = leaderFd >= 0 && read(leaderFd, &startRead, sizeof(startRead)) != -1;
+}
+
+/**
+ * Stops counting on the calling thread, and adds what it counted since startPerfCounters to counts, under the
+ * given thread number. Counts of a group that was multiplexed are scaled up by the share of the time it was
+ * enabled that it was actually counting.
+ */
+void stopPerfCounters(PerfCounts *counts, int thread)
+{
+    GroupRead stopRead;
+    if (!started || counts == NULL || read(leaderFd, &stopRead, sizeof(stopRead)) == -1)
+    {
+        return;
+    }
+    started = false;
+
+    // a team larger than the context's shares the last slot, which is why the counts are added atomically
+    ThreadCounts *slot = &counts->threads[thread < counts->nThreads ? thread : counts->nThreads - 1];
+    unsigned long long enabled = stopRead.timeEnabled - startRead.timeEnabled;
+    unsigned long long running = stopRead.timeRunning - startRead.timeRunning;
+    if (running == 0)
+    {
+        // the group never got onto the PMU, so there is nothing to scale
+        return;
+    }
+    for (int counter = 0; counter < N_COUNTERS; counter++)
+    {
+        if (counterIndex[counter] == -1)
+        {
+            continue;
+        }
+        int index = counterIndex[counter];
+        unsigned long long value = stopRead.values[index] - startRead.values[index];
+        if (running < enabled)
+        {
+            value = (unsigned long long) ((double) value * enabled / running);
+        }
+        #pragma omp atomic
+        slot->values[counter] += value;
+        #pragma omp atomic write
+        slot->valid[counter] = true;
+    }
+    if (running < enabled)
+    {
+        #pragma omp atomic write
+        slot->scaled = true;
+    }
+    #pragma omp atomic write
+    slot->sampled = true;
+}
+
+/**
+ * Closes the calling thread's counters once a run is over. They are opened again if the thread counts once
+ * more.
+ */
+void finishPerfCounters(void)
+{
+    if (leaderFd < 0)
+    {
+        return;
+    }
+    for (int counter = 0; counter < N_COUNTERS; counter++)
+    {
+        if (counterFds[counter] != -1)
+        {
+            close(counterFds[counter]);
+        }
+    }
+    leaderFd = -2;
+    started = false;
+}
+
+/**
+ * Prints the counts of every thread that sampled the window of generations [firstGeneration, lastGeneration],
+ * which took seconds of wall time, and their sum, then clears counts for the next window. Does nothing if no
+ * counters were available.
+ */
+void reportPerfWindow(PerfCounts *counts, int firstGeneration, int lastGeneration, double seconds)
+{
+    unsigned long long totals[N_COUNTERS] = {0};
+    bool valid[N_COUNTERS] = {false};
+    bool sampled = false;
+    bool scaled = false;
+
+    for (int thread = 0; thread < counts->nThreads; thread++)
+    {
+        if (!counts->threads[thread].sampled)
+        {
+            continue;
+        }
+        sampled = true;
+        scaled |= counts->threads[thread].scaled;
+        for (int counter = 0; counter < N_COUNTERS; counter++)
+        {
+            totals[counter] += counts->threads[thread].values[counter];
+            valid[counter] |= counts->threads[thread].valid[counter];
+        }
+    }
+    if (!sampled)
+    {
+        return;
+    }
+
+    // contexts stepped side by side report at the same time; each report is kept in one piece
+    flockfile(stderr);
+    fprintf(stderr, "perf generations %d-%d (%.6f s):", firstGeneration, lastGeneration, seconds);
+    for (int counter = 0; counter < N_COUNTERS; counter++)
+    {
+        if (valid[counter])
+        {
+            fprintf(stderr, " %s %llu,", counterSpecs[counter].name, totals[counter]);
+        }
+        else
+        {
+            fprintf(stderr, " %s n/a,", counterSpecs[counter].name);
+        }
+    }
+    if (valid[COUNTER_CYCLES] && valid[COUNTER_INSTRUCTIONS] && totals[COUNTER_CYCLES] > 0)
+    {
+        fprintf(stderr, " IPC %.2f,", (double) totals[COUNTER_INSTRUCTIONS] / totals[COUNTER_CYCLES]);
+    }
+    if (valid[COUNTER_LLC_MISSES] && seconds > 0)
+    {
+        fprintf(stderr, " ~%.1f MB/s from memory", totals[COUNTER_LLC_MISSES] * CACHE_LINE_SIZE / seconds / 1e6);
+    }
+    if (scaled)
+    {
+        fprintf(stderr, " (scaled from multiplexed counters)");
+    }
+    fprintf(stderr, "\n");
+
+    for (int thread = 0; thread < counts->nThreads; thread++)
+    {
+        if (!counts->threads[thread].sampled)
+        {
+            continue;
+        }
+        unsigned long long *values = counts->threads[thread].values;
+        fprintf(stderr, "  thread %d: cycles %llu, instructions %llu, IPC %.2f, LLC misses %llu, dTLB misses %llu\n", thread,
+                values[COUNTER_CYCLES], values[COUNTER_INSTRUCTIONS],
+                values[COUNTER_CYCLES] > 0 ? (double) values[COUNTER_INSTRUCTIONS] / values[COUNTER_CYCLES] : 0,
+                values[COUNTER_LLC_MISSES], values[COUNTER_DTLB_MISSES]);
+    }
+    funlockfile(stderr);
+    memset(counts->threads, 0, sizeof(ThreadCounts) * counts->nThreads);
+}
+
+/**
+ * Opens as many of the counters as the kernel allows on the calling thread, as a single group so that they
+ * are scheduled and read together. Counters that cannot be opened are left out of the group. The counters
+ * run from the moment they are opened; each stretch of work is measured as the difference of two reads.
+ */
+static void openPerfCounters(void)
+{
+    leaderFd = -1;
+    nOpened = 0;
+    int firstErrno = 0;
+
+    for (int counter = 0; counter < N_COUNTERS; counter++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counterSpecs[counter].type;
+        attr.config = counterSpecs[counter].config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leaderFd, 0);
+        if (fd == -1)
+        {
+            if (firstErrno == 0)
+            {
+                firstErrno = errno;
+            }
+            counterIndex[counter] = -1;
+            counterFds[counter] = -1;
+            continue;
+        }
+        if (leaderFd == -1)
+        {
+            leaderFd = fd;
+        }
+        counterIndex[counter] = nOpened++;
+        counterFds[counter] = fd;
+    }
+
+    if (leaderFd == -1)
+    {
+        #pragma omp critical(perfWarning)
+        if (!warned)
+        {
+            warned = true;
+            fprintf(stderr, "perf counters unavailable (%s); continuing without them\n", strerror(firstErrno));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdbool.h>
+#include "settings.h"
+
+typedef struct PerfCounts PerfCounts;
+
+int getPerfWindow(void);
+PerfCounts *createPerfCounts(int nThreads);
+void freePerfCounts(PerfCounts *counts);
+void startPerfCounters(void);
+void stopPerfCounters(PerfCounts *counts, int thread);
+void finishPerfCounters(void);
+void reportPerfWindow(PerfCounts *counts, int firstGeneration, int lastGeneration, double seconds);
+
+/**
+ * Counter hooks for the generation loop. PERF_THREAD_START and PERF_THREAD_STOP are called by every thread
+ * around its share of the kernel, the latter with the counts of the context being stepped (NULL counts
+ * nothing), and PERF_THREAD_FINISH by every thread of the team once a run is over. The ensemble engine has no
+ * hooks, so its runs are not counted. With SAMPLE_PERF_COUNTERS set to 0 every hook expands to nothing.
+ */
+#if SAMPLE_PERF_COUNTERS
+#define PERF_THREAD_START() startPerfCounters()
+#define PERF_THREAD_STOP(counts) stopPerfCounters(counts, omp_get_thread_num())
+#define PERF_THREAD_FINISH() finishPerfCounters()
+#else
+#define PERF_THREAD_START() ((void) 0)
+#define PERF_THREAD_STOP(counts) ((void) 0)
+#define PERF_THREAD_FINISH() ((void) 0)
+#endif
+
+#endif
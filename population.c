@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "population.h"
+#include "rules.h"
+
+/**
+ * Population time series, as CSV or as a compact binary file.
+ *
+ * The CSV has a header line and then one line per generation and live faction (1 to 9):
+ *     generation,faction,live,births,landed,natural_deaths,fighting_deaths
+ *
+ * The binary file starts with a 16-byte header: the magic "GOIP", then the format version (1) and the number
+ * of factions per record (GOI_MAX_FACTIONS) as 32-bit integers, then 4 zero bytes. Each record is then the
+ * generation followed by the live, births, landed, naturalDeaths and fightingDeaths arrays of
+ * GoiPopulationStats, dead faction included, all as 64-bit integers. Integers are in the host's byte order.
+ *
+ * A region dump is the region index of a context (see goi_enable_regions) at a series of generations, in the
+ * same spirit. It starts with a 32-byte header: the magic "GOIR", then the format version (1), the number of
+ * factions per tile (GOI_MAX_FACTIONS), the tile size, the rows and columns of the world and the rows and
+ * columns of tiles, as 32-bit integers. Each record is then the generation followed by the counts of every
+ * tile as from goi_region_tiles, all as 64-bit integers.
+ */
+
+#define CSV_HEADER "generation,faction,live,births,landed,natural_deaths,fighting_deaths\n"
+#define BINARY_MAGIC "GOIP"
+#define BINARY_VERSION 1
+#define REGION_MAGIC "GOIR"
+#define REGION_VERSION 1
+
+// 64-bit integers per binary record
+#define RECORD_FIELDS (1 + 5 * GOI_MAX_FACTIONS)
+
+/**
+ * Creates (or truncates) the file at path and writes the header of a CSV or, if binary, binary series.
+ * -1 is returned on error.
+ */
+int openPopulationWriter(PopulationWriter *writer, const char *path, bool binary)
+{
+    writer->binary = binary;
+    writer->file = fopen(path, binary ? "wb" : "w");
+    if (writer->file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing.\n", path);
+        return -1;
+    }
+
+    int ret;
+    if (binary)
+    {
+        uint32_t header[4] = {0, BINARY_VERSION, GOI_MAX_FACTIONS, 0};
+        memcpy(header, BINARY_MAGIC, sizeof(header[0]));
+        ret = fwrite(header, sizeof(header), 1, writer->file) == 1 ? 0 : -1;
+    }
+    else
+    {
+        ret = fputs(CSV_HEADER, writer->file) == EOF ? -1 : 0;
+    }
+    if (ret == -1)
+    {
+        fprintf(stderr, "Failed to write to %s.\n", path);
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+    return ret;
+}
+
+/**
+ * Appends the population of generation to the series. -1 is returned on error.
+ */
+int writePopulation(PopulationWriter *writer, int generation, const GoiPopulationStats *population)
+{
+    if (writer->binary)
+    {
+        int64_t record[RECORD_FIELDS];
+        int64_t *field = record;
+        *field++ = generation;
+        for (int faction = 0; faction < GOI_MAX_FACTIONS; faction++)
+        {
+            field[faction] = population->live[faction];
+            field[GOI_MAX_FACTIONS + faction] = population->births[faction];
+            field[2 * GOI_MAX_FACTIONS + faction] = population->landed[faction];
+            field[3 * GOI_MAX_FACTIONS + faction] = population->naturalDeaths[faction];
+            field[4 * GOI_MAX_FACTIONS + faction] = population->fightingDeaths[faction];
+        }
+        return fwrite(record, sizeof(record), 1, writer->file) == 1 ? 0 : -1;
+    }
+
+    for (int faction = DEAD_FACTION + 1; faction < GOI_MAX_FACTIONS; faction++)
+    {
+        if (fprintf(writer->file, "%d,%d,%ld,%ld,%ld,%ld,%ld\n", generation, faction, population->live[faction],
+                    population->births[faction], population->landed[faction], population->naturalDeaths[faction],
+                    population->fightingDeaths[faction]) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Closes the series. -1 is returned if it could not be written out in full.
+ */
+int closePopulationWriter(PopulationWriter *writer)
+{
+    if (writer->file == NULL)
+    {
+        return 0;
+    }
+    bool failed = ferror(writer->file);
+    failed |= fclose(writer->file) == EOF;
+    writer->file = NULL;
+    return failed ? -1 : 0;
+}
+
+/**
+ * Counts the cells of each faction among the nCells cells of world into population, with no births or
+ * deaths, as for generation 0.
+ */
+void countPopulation(const int *world, long nCells, GoiPopulationStats *population)
+{
+    memset(population, 0, sizeof(GoiPopulationStats));
+    for (long i = 0; i < nCells; i++)
+    {
+        population->live[world[i]]++;
+    }
+}
+
+/**
+ * Creates (or truncates) the file at path and writes the header of a dump of the region index of ctx.
+ * NULL is returned on error.
+ */
+FILE *openRegionDump(const char *path, const GoiContext *ctx)
+{
+    int nTileRows;
+    int nTileCols;
+    if (goi_region_tiles(ctx, &nTileRows, &nTileCols) == NULL)
+    {
+        return NULL;
+    }
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing.\n", path);
+        return NULL;
+    }
+
+    uint32_t header[8] = {0, REGION_VERSION, GOI_MAX_FACTIONS, goi_region_tile_size(ctx), goi_rows(ctx), goi_cols(ctx), nTileRows, nTileCols};
+    memcpy(header, REGION_MAGIC, sizeof(header[0]));
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+    {
+        fprintf(stderr, "Failed to write to %s.\n", path);
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * Appends the region index of ctx at its current generation to a region dump. -1 is returned on error.
+ */
+int writeRegionDump(FILE *file, const GoiContext *ctx)
+{
+    int nTileRows;
+    int nTileCols;
+    const long *tiles = goi_region_tiles(ctx, &nTileRows, &nTileCols);
+    int64_t generation = goi_generation(ctx);
+    if (tiles == NULL || fwrite(&generation, sizeof(generation), 1, file) != 1)
+    {
+        return -1;
+    }
+    // long is 64 bits wide wherever this builds (LP64)
+    size_t nCounts = (size_t) nTileRows * nTileCols * GOI_MAX_FACTIONS;
+    return fwrite(tiles, sizeof(long), nCounts, file) == nCounts ? 0 : -1;
+}
@@ -0,0 +1,24 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "goi.h"
+
+/**
+ * A population time series being written, one record per observed generation.
+ */
+typedef struct
+{
+    FILE *file;
+    bool binary;
+} PopulationWriter;
+
+int openPopulationWriter(PopulationWriter *writer, const char *path, bool binary);
+int writePopulation(PopulationWriter *writer, int generation, const GoiPopulationStats *population);
+int closePopulationWriter(PopulationWriter *writer);
+void countPopulation(const int *world, long nCells, GoiPopulationStats *population);
+FILE *openRegionDump(const char *path, const GoiContext *ctx);
+int writeRegionDump(FILE *file, const GoiContext *ctx);
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "profile.h"
+
+#if PROFILE_PHASES
+
+// per-thread kernel times beyond this many threads are folded into the last slot
+#define MAX_PROFILE_THREADS 256
+
+static const char *phaseNames[N_PHASES] = {
+    "input parse",
+    "world init",
+    "halo refresh",
+    "invasion copy",
+    "kernel",
+    "region index",
+    "buffer swap/free",
+    "export",
+    "output write",
+};
+
+static double phaseTimes[N_PHASES];
+static long phaseCalls[N_PHASES];
+
+// each thread only touches its own slot; padding keeps the slots on separate cache lines
+static struct
+{
+    double seconds;
+    long calls;
+    char padding[48];
+} threadKernelTimes[MAX_PROFILE_THREADS];
+
+static void printProfile(void);
+
+/**
+ * Arranges for the profile summary to be printed when the program exits. Call once, before any phase is timed.
+ */
+void initProfile(void)
+{
+    atexit(printProfile);
+}
+
+/**
+ * Adds seconds to the total of phase. Safe to call from several threads at once.
+ */
+void addPhaseTime(ProfilePhase phase, double seconds)
+{
+    #pragma omp atomic
+    phaseTimes[phase] += seconds;
+    #pragma omp atomic
+    phaseCalls[phase]++;
+}
+
+/**
+ * Returns the calling thread's number in the innermost enclosing team of more than one thread, 0 outside of
+ * any. The jobs of a packed batch are stepped by teams of one inside the batch's own team, so their kernel
+ * time is put down to the batch thread that ran them rather than all to thread 0.
+ */
+int profileThread(void)
+{
+    for (int level = omp_get_level(); level > 0; level--)
+    {
+        if (omp_get_team_size(level) > 1)
+        {
+            return omp_get_ancestor_thread_num(level);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Adds seconds to the kernel time of thread (as numbered by profileThread).
+ */
+void addThreadKernelTime(int thread, double seconds)
+{
+    if (thread >= MAX_PROFILE_THREADS)
+    {
+        thread = MAX_PROFILE_THREADS - 1;
+    }
+    #pragma omp atomic
+    threadKernelTimes[thread].seconds += seconds;
+    #pragma omp atomic
+    threadKernelTimes[thread].calls++;
+}
+
+/**
+ * Writes the per-phase and per-thread tables to stderr.
+ */
+static void printProfile(void)
+{
+    double total = 0;
+    for (int phase = 0; phase < N_PHASES; phase++)
+    {
+        total += phaseTimes[phase];
+    }
+
+    fprintf(stderr, "\n%-18s %12s %10s %8s\n", "phase", "seconds", "calls", "share");
+    for (int phase = 0; phase < N_PHASES; phase++)
+    {
+        fprintf(stderr, "%-18s %12.6f %10ld %7.1f%%\n", phaseNames[phase], phaseTimes[phase], phaseCalls[phase],
+                total > 0 ? 100 * phaseTimes[phase] / total : 0);
+    }
+    fprintf(stderr, "%-18s %12.6f\n", "total", total);
+
+    int nThreads = 0;
+    double sum = 0;
+    double max = 0;
+    for (int thread = 0; thread < MAX_PROFILE_THREADS; thread++)
+    {
+        if (threadKernelTimes[thread].calls == 0)
+        {
+            continue;
+        }
+        nThreads = thread + 1;
+        sum += threadKernelTimes[thread].seconds;
+        if (threadKernelTimes[thread].seconds > max)
+        {
+            max = threadKernelTimes[thread].seconds;
+        }
+    }
+    if (nThreads == 0)
+    {
+        return;
+    }
+
+    fprintf(stderr, "\n%-18s %12s %10s %8s\n", "kernel thread", "seconds", "calls", "of max");
+    for (int thread = 0; thread < nThreads; thread++)
+    {
+        fprintf(stderr, "%-18d %12.6f %10ld %7.1f%%\n", thread, threadKernelTimes[thread].seconds, threadKernelTimes[thread].calls,
+                max > 0 ? 100 * threadKernelTimes[thread].seconds / max : 0);
+    }
+    // 1.00 is perfectly balanced; the slowest thread sets the pace of every generation
+    fprintf(stderr, "%-18s %12.2f\n", "imbalance max/avg", sum > 0 ? max / (sum / nThreads) : 0);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "settings.h"
+
+typedef enum
+{
+    PHASE_PARSE,
+    PHASE_INIT,
+    PHASE_HALO,
+    PHASE_INVASION_COPY,
+    PHASE_KERNEL,
+    PHASE_REGIONS,
+    PHASE_SWAP,
+    PHASE_EXPORT,
+    PHASE_OUTPUT,
+    N_PHASES
+} ProfilePhase;
+
+void initProfile(void);
+void addPhaseTime(ProfilePhase phase, double seconds);
+int profileThread(void);
+void addThreadKernelTime(int thread, double seconds);
+
+/**
+ * Profiling hooks. PROFILE_START and PROFILE_END must be paired within one block, naming the same phase.
+ * With PROFILE_PHASES set to 0 every hook expands to nothing.
+ */
+#if PROFILE_PHASES
+#include "util.h"
+#define PROFILE_INIT() initProfile()
+#define PROFILE_START(phase) double profileStart_##phase = getWallTime()
+#define PROFILE_END(phase) addPhaseTime(phase, getWallTime() - profileStart_##phase)
+#define PROFILE_THREAD_START() double profileThreadStart = getWallTime()
+#define PROFILE_THREAD_END() addThreadKernelTime(profileThread(), getWallTime() - profileThreadStart)
+#else
+#define PROFILE_INIT() ((void) 0)
+#define PROFILE_START(phase) ((void) 0)
+#define PROFILE_END(phase) ((void) 0)
+#define PROFILE_THREAD_START() ((void) 0)
+#define PROFILE_THREAD_END() ((void) 0)
+#endif
+
+#endif
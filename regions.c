@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+#include "regions.h"
+#include "rules.h"
+
+/**
+ * The region index: the population of every faction (dead cells included) in every tileSize x tileSize tile
+ * of the world, summed up a pyramid so that any rectangle of tiles is answered from a handful of entries.
+ *
+ * The pyramid is a two-dimensional segment tree. Level (a, b) sums blocks of 2^a x 2^b tiles, for every a up
+ * to where one block spans all tile rows and every b likewise for columns; level (0, 0) is the tiles
+ * themselves. A rectangle splits into at most 2 log2(tile rows) aligned row ranges and as many column ranges,
+ * and each pair is one entry, so a query reads O(log^2) entries and never the cells. The levels hold about
+ * four times as many entries as there are tiles.
+ *
+ * The engine keeps the index up to date from the counting kernels: each generation it tallies the tiles
+ * afresh into tally, and commitRegionTally pushes the difference of only the tiles that changed up the
+ * pyramid.
+ */
+
+struct RegionIndex
+{
+    int tileSize;
+    int nRows;
+    int nCols;
+    int nTileRows;
+    int nTileCols;
+    int nRowLevels;
+    int nColLevels;
+
+    // [a * nColLevels + b] -> counts of level (a, b), GOI_MAX_FACTIONS per block, blocks in row-major order
+    long **levels;
+    // the tiles of the generation being computed, laid out as level (0, 0)
+    long *tally;
+};
+
+static int countLevels(int n);
+static int levelSize(int n, int level);
+static int splitRange(int first, int count, int *levels, int *indices);
+static void addToPyramid(RegionIndex *index, int tileRow, int tileCol, const long *delta);
+
+/**
+ * Creates an index of the nRows x nCols world in tiles of tileSize x tileSize cells (the last row and column
+ * of tiles may be smaller), with every count 0. Returns NULL if out of memory.
+ */
+RegionIndex *createRegionIndex(int nRows, int nCols, int tileSize)
+{
+    RegionIndex *index = calloc(1, sizeof(RegionIndex));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    index->tileSize = tileSize;
+    index->nRows = nRows;
+    index->nCols = nCols;
+    index->nTileRows = (nRows + tileSize - 1) / tileSize;
+    index->nTileCols = (nCols + tileSize - 1) / tileSize;
+    index->nRowLevels = countLevels(index->nTileRows);
+    index->nColLevels = countLevels(index->nTileCols);
+
+    index->levels = calloc((size_t) index->nRowLevels * index->nColLevels, sizeof(long *));
+    index->tally = malloc(sizeof(long) * GOI_MAX_FACTIONS * index->nTileRows * index->nTileCols);
+    if (index->levels == NULL || index->tally == NULL)
+    {
+        freeRegionIndex(index);
+        return NULL;
+    }
+    for (int a = 0; a < index->nRowLevels; a++)
+    {
+        for (int b = 0; b < index->nColLevels; b++)
+        {
+            long nBlocks = (long) levelSize(index->nTileRows, a) * levelSize(index->nTileCols, b);
+            index->levels[a * index->nColLevels + b] = calloc(nBlocks * GOI_MAX_FACTIONS, sizeof(long));
+            if (index->levels[a * index->nColLevels + b] == NULL)
+            {
+                freeRegionIndex(index);
+                return NULL;
+            }
+        }
+    }
+    return index;
+}
+
+/**
+ * Frees index. Does nothing if index is NULL.
+ */
+void freeRegionIndex(RegionIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+    if (index->levels != NULL)
+    {
+        for (int i = 0; i < index->nRowLevels * index->nColLevels; i++)
+        {
+            free(index->levels[i]);
+        }
+    }
+    free(index->levels);
+    free(index->tally);
+    free(index);
+}
+
+/**
+ * Rebuilds index from layout, nRows x nCols cells in row-major order.
+ */
+void loadRegionIndex(RegionIndex *index, const int *layout)
+{
+    long *tally = beginRegionTally(index);
+    for (int row = 0; row < index->nRows; row++)
+    {
+        const int *cells = layout + (long) row * index->nCols;
+        long *tiles = tally + (long) (row / index->tileSize) * index->nTileCols * GOI_MAX_FACTIONS;
+        for (int col = 0; col < index->nCols; col++)
+        {
+            tiles[(col / index->tileSize) * GOI_MAX_FACTIONS + cells[col]]++;
+        }
+    }
+    commitRegionTally(index);
+}
+
+/**
+ * Clears and returns the tally for the next generation: GOI_MAX_FACTIONS counts per tile, tiles in
+ * row-major order. The caller adds the population of every tile to it, then calls commitRegionTally.
+ */
+long *beginRegionTally(RegionIndex *index)
+{
+    memset(index->tally, 0, sizeof(long) * GOI_MAX_FACTIONS * index->nTileRows * index->nTileCols);
+    return index->tally;
+}
+
+/**
+ * Makes the tally the index's new population, updating the pyramid above the tiles that changed.
+ */
+void commitRegionTally(RegionIndex *index)
+{
+    const long *tiles = index->levels[0];
+    for (int tileRow = 0; tileRow < index->nTileRows; tileRow++)
+    {
+        for (int tileCol = 0; tileCol < index->nTileCols; tileCol++)
+        {
+            long offset = ((long) tileRow * index->nTileCols + tileCol) * GOI_MAX_FACTIONS;
+            if (memcmp(tiles + offset, index->tally + offset, sizeof(long) * GOI_MAX_FACTIONS) == 0)
+            {
+                continue;
+            }
+            long delta[GOI_MAX_FACTIONS];
+            for (int faction = 0; faction < GOI_MAX_FACTIONS; faction++)
+            {
+                delta[faction] = index->tally[offset + faction] - tiles[offset + faction];
+            }
+            addToPyramid(index, tileRow, tileCol, delta);
+        }
+    }
+}
+
+/**
+ * Sets counts (GOI_MAX_FACTIONS entries) to the population of each faction in the nTileRows x nTileCols
+ * tiles from tile (tileRow, tileCol). -1 is returned if the rectangle is empty or not within the tiles.
+ */
+int queryRegionIndex(const RegionIndex *index, int tileRow, int tileCol, int nTileRows, int nTileCols, long *counts)
+{
+    if (tileRow < 0 || tileCol < 0 || nTileRows <= 0 || nTileCols <= 0 || nTileRows > index->nTileRows - tileRow ||
+        nTileCols > index->nTileCols - tileCol)
+    {
+        return -1;
+    }
+
+    // 2 entries per level at most
+    int rowLevels[64];
+    int rowIndices[64];
+    int colLevels[64];
+    int colIndices[64];
+    int nRowParts = splitRange(tileRow, nTileRows, rowLevels, rowIndices);
+    int nColParts = splitRange(tileCol, nTileCols, colLevels, colIndices);
+
+    memset(counts, 0, sizeof(long) * GOI_MAX_FACTIONS);
+    for (int i = 0; i < nRowParts; i++)
+    {
+        for (int j = 0; j < nColParts; j++)
+        {
+            int b = colLevels[j];
+            const long *level = index->levels[rowLevels[i] * index->nColLevels + b];
+            const long *block = level + ((long) rowIndices[i] * levelSize(index->nTileCols, b) + colIndices[j]) * GOI_MAX_FACTIONS;
+            for (int faction = 0; faction < GOI_MAX_FACTIONS; faction++)
+            {
+                counts[faction] += block[faction];
+            }
+        }
+    }
+    return 0;
+}
+
+int regionTileSize(const RegionIndex *index)
+{
+    return index->tileSize;
+}
+
+int regionTileRows(const RegionIndex *index)
+{
+    return index->nTileRows;
+}
+
+int regionTileCols(const RegionIndex *index)
+{
+    return index->nTileCols;
+}
+
+/**
+ * Returns the population of every tile: GOI_MAX_FACTIONS counts per tile, tiles in row-major order.
+ */
+const long *regionTiles(const RegionIndex *index)
+{
+    return index->levels[0];
+}
+
+// countLevels returns how many times n tiles can be halved, rounding up, until one block spans them, plus 1.
+static int countLevels(int n)
+{
+    int nLevels = 1;
+    while (levelSize(n, nLevels - 1) > 1)
+    {
+        nLevels++;
+    }
+    return nLevels;
+}
+
+// levelSize returns how many blocks of 2^level tiles it takes to span n tiles.
+static int levelSize(int n, int level)
+{
+    return (int) (((long) n + (1L << level) - 1) >> level);
+}
+
+// splitRange splits the count tiles from first into aligned blocks, as (level, index) pairs, the way a
+// segment tree is read bottom-up. Returns the number of blocks.
+static int splitRange(int first, int count, int *levels, int *indices)
+{
+    int nParts = 0;
+    long lo = first;
+    long hi = (long) first + count;
+    for (int level = 0; lo < hi; level++)
+    {
+        if (lo & 1)
+        {
+            levels[nParts] = level;
+            indices[nParts++] = (int) lo++;
+        }
+        if (hi & 1)
+        {
+            levels[nParts] = level;
+            indices[nParts++] = (int) --hi;
+        }
+        lo >>= 1;
+        hi >>= 1;
+    }
+    return nParts;
+}
+
+// addToPyramid adds delta to tile (tileRow, tileCol) and to every block above it.
+static void addToPyramid(RegionIndex *index, int tileRow, int tileCol, const long *delta)
+{
+    for (int a = 0; a < index->nRowLevels; a++)
+    {
+        for (int b = 0; b < index->nColLevels; b++)
+        {
+            long *level = index->levels[a * index->nColLevels + b];
+            long *block = level + ((long) (tileRow >> a) * levelSize(index->nTileCols, b) + (tileCol >> b)) * GOI_MAX_FACTIONS;
+            for (int faction = 0; faction < GOI_MAX_FACTIONS; faction++)
+            {
+                block[faction] += delta[faction];
+            }
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include "goi.h"
+
+typedef struct RegionIndex RegionIndex;
+
+RegionIndex *createRegionIndex(int nRows, int nCols, int tileSize);
+void freeRegionIndex(RegionIndex *index);
+void loadRegionIndex(RegionIndex *index, const int *layout);
+long *beginRegionTally(RegionIndex *index);
+void commitRegionTally(RegionIndex *index);
+int queryRegionIndex(const RegionIndex *index, int tileRow, int tileCol, int nTileRows, int nTileCols, long *counts);
+int regionTileSize(const RegionIndex *index);
+int regionTileRows(const RegionIndex *index);
+int regionTileCols(const RegionIndex *index);
+const long *regionTiles(const RegionIndex *index);
+
+#endif
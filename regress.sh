@@ -0,0 +1,130 @@
+#!/bin/bash
+#
+# Regression suite over the bundled sample inputs. Runs every sample with each thread count, checks its death
+# toll against the expected output (or, for the sets that have none, against the toll in the baseline), and
+# compares its wall time with the baseline. Exits non-zero if a toll is wrong or a run slowed down by more than
+# the tolerance.
+#
+# Usage: ./regress.sh [--threads 1,2,4] [--tolerance PERCENT] [--reps N] [--match REGEX] [--baseline PATH] [--update]
+#
+# The baseline holds one line per input and thread count: the input, the thread count, the best wall time in
+# seconds and the death toll. Timings only compare on the machine they were taken on, so no baseline ships with
+# the repo: a run without one records it, and --update records it afresh (after a deliberate change in speed,
+# say). Runs faster than NOISE_FLOOR seconds are never flagged, as their timings are mostly noise.
+
+set -u
+cd "$(dirname "$0")"
+
+THREADS=1,2,4
+TOLERANCE=${GOI_REGRESS_TOLERANCE:-20}
+REPS=1
+MATCH=
+BASELINE=${GOI_REGRESS_BASELINE:-regress.baseline}
+UPDATE=false
+NOISE_FLOOR=0.05
+BIN=./goi-parallel.out
+
+while [ $# -gt 0 ]; do
+    case $1 in
+    --threads) THREADS=$2; shift 2 ;;
+    --tolerance) TOLERANCE=$2; shift 2 ;;
+    --reps) REPS=$2; shift 2 ;;
+    --match) MATCH=$2; shift 2 ;;
+    --baseline) BASELINE=$2; shift 2 ;;
+    --update) UPDATE=true; shift ;;
+    *)
+        echo "Usage: $0 [--threads 1,2,4] [--tolerance PERCENT] [--reps N] [--match REGEX] [--baseline PATH] [--update]" >&2
+        exit 2
+        ;;
+    esac
+done
+
+if [ ! -x $BIN ]; then
+    echo "$BIN is missing; run make build first." >&2
+    exit 2
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "No baseline at $BASELINE; recording one."
+    UPDATE=true
+fi
+
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+newBaseline=$scratch/baseline
+
+# runSample runs input with threads threads REPS times, and prints the best wall time and the death toll
+runSample() {
+    local best= toll=
+    for ((rep = 0; rep < REPS; rep++)); do
+        local start end
+        start=$(date +%s.%N)
+        if ! $BIN "$1" "$scratch/toll" "$2" >/dev/null 2>"$scratch/err"; then
+            return 1
+        fi
+        end=$(date +%s.%N)
+        best=$(awk -v s="$start" -v e="$end" -v b="$best" 'BEGIN { t = e - s; printf "%.4f", (b == "" || t < b + 0) ? t : b }')
+        toll=$(cat "$scratch/toll")
+    done
+    echo "$best $toll"
+}
+
+failures=0
+for input in sample_inputs/*.in sample_inputs_varies_inv/*.in sample_inputs_varies_gen/*.in sample_inputs_varies_size/*.in; do
+    if [ -n "$MATCH" ] && ! [[ $input =~ $MATCH ]]; then
+        continue
+    fi
+    expectedPath=$(dirname "$input" | sed 's/sample_inputs/sample_outputs/')/$(basename "$input" .in).out
+    for threads in ${THREADS//,/ }; do
+        if ! result=$(runSample "$input" "$threads"); then
+            printf "%-40s %2s threads  FAILED to run\n" "$input" "$threads"
+            sed 's/^/    /' "$scratch/err"
+            failures=$((failures + 1))
+            continue
+        fi
+        read -r seconds toll <<<"$result"
+        read -r baseSeconds baseToll < <(awk -v i="$input" -v t="$threads" '$1 == i && $2 == t { print $3, $4 }' "$BASELINE" 2>/dev/null)
+
+        # the expected output is the reference where there is one, and the baseline's toll where there is not
+        expected=
+        if [ -f "$expectedPath" ]; then
+            expected=$(cat "$expectedPath")
+        elif [ -n "${baseToll:-}" ]; then
+            expected=$baseToll
+        fi
+        verdict="toll $toll"
+        if [ -n "$expected" ] && [ "$toll" != "$expected" ]; then
+            verdict="toll $toll, EXPECTED $expected"
+            failures=$((failures + 1))
+        fi
+
+        timing=
+        if [ -n "${baseSeconds:-}" ]; then
+            read -r change slow < <(awk -v t="$seconds" -v b="$baseSeconds" -v tol="$TOLERANCE" -v floor="$NOISE_FLOOR" 'BEGIN {
+                printf "%+.0f%% %d\n", (b > 0 ? 100 * (t - b) / b : 0), (t > floor && t > b * (1 + tol / 100)) }')
+            timing="(baseline ${baseSeconds}s, $change)"
+            if [ "$slow" = 1 ] && [ "$UPDATE" = false ]; then
+                timing="$timing SLOWER than the ${TOLERANCE}% tolerance"
+                failures=$((failures + 1))
+            fi
+        fi
+        printf "%-40s %2s threads %9ss  %s %s\n" "$input" "$threads" "$seconds" "$verdict" "$timing"
+        echo "$input $threads $seconds $toll" >>"$newBaseline"
+        unset baseSeconds baseToll
+    done
+done
+
+if [ "$UPDATE" = true ]; then
+    # keep the lines of the inputs and thread counts that were not run this time
+    if [ -f "$BASELINE" ]; then
+        awk 'NR == FNR { ran[$1 " " $2] = 1; next } !(($1 " " $2) in ran)' "$newBaseline" "$BASELINE" >"$scratch/kept"
+        cat "$scratch/kept" >>"$newBaseline"
+    fi
+    sort -o "$BASELINE" "$newBaseline"
+    echo "Recorded the baseline in $BASELINE."
+fi
+
+if [ $failures -gt 0 ]; then
+    echo "$failures regression(s)."
+    exit 1
+fi
+echo "All samples passed."
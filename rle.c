@@ -0,0 +1,530 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rle.h"
+#include "profile.h"
+#include "perfcounters.h"
+#include <omp.h>
+
+/**
+ * The run-length engine: each row is stored as its runs of live cells, (start, length, faction) in ascending
+ * order, and dead cells are not stored at all. It suits worlds of long dead stretches with narrow active
+ * bands, and large uniform blocks, whose cells the dense engines would visit one by one.
+ *
+ * A row of the next generation is computed by merging the run lists of the row and of its neighbours above
+ * and below, along with the row's invaders, into intervals over which all four are constant. Every cell
+ * strictly inside an interval sees the same neighbourhood, so the interval only needs its two edge columns
+ * and one interior column to be computed; intervals of one or two cells are kept whole. The columns kept
+ * make up a compressed row, whose neighbours are still the right ones, and the ordinary row kernel computes
+ * it; where runs are short the compressed row is just the dense row, so the dense kernel takes over there.
+ * The results are expanded back into runs, each interior column standing for the width of its interval.
+ *
+ * Rows with no runs around them and no invaders are skipped, so work and memory scale with the number of
+ * runs rather than with the area of the world. Worlds are bounded: cells beyond the edges stay dead.
+ */
+
+typedef struct
+{
+    int start;
+    int length;
+    int faction;
+} Run;
+
+typedef struct
+{
+    Run *runs;
+    int nRuns;
+    int capacity;
+} RunRow;
+
+// a compressed row being computed by one thread. The cell arrays have a dead halo at [0] and [nColumns + 1],
+// like the rows of the dense engines; widths[k] is how many cells of the row column k stands for.
+typedef struct
+{
+    int *above;
+    int *row;
+    int *below;
+    int *invaders;
+    int *next;
+    int *widths;
+    int capacity; // in columns, halo included
+} Scratch;
+
+struct RleWorld
+{
+    int nRows;
+    int nCols;
+    RunRow *rows;     // the current generation...
+    RunRow *nextRows; // ...and the one being computed
+    int nPlans;
+    RunRow **plans; // [invasion][row], encoded once by loadRleWorld
+    Scratch *scratch; // per thread
+    int nScratch;
+};
+
+// where cursorValue has got to in a row's runs
+typedef struct
+{
+    const Run *run;
+    const Run *end;
+} Cursor;
+
+static const RunRow noRuns = {0};
+
+static void freeRunRows(RunRow *rows, int nRows);
+static int encodeRows(RunRow *rows, const int *layout, int nRows, int nCols);
+static int reserveRuns(RunRow *row, long nRuns);
+static void appendRun(RunRow *row, int start, int length, int faction);
+static int reserveScratch(RleWorld *world, int nThreads);
+static int growScratch(Scratch *scratch, long nColumns);
+static long nextRunRow(RleWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live, const RunRow *plan,
+                       int row, Scratch *scratch, GoiPopulationStats *population);
+static int compressRows(int nCols, const RunRow *above, const RunRow *row, const RunRow *below, const RunRow *invaders,
+                        Scratch *scratch);
+static int cursorValue(Cursor *cursor, int col, int *end);
+static long repeatCell(const RuleTable *rules, const Scratch *scratch, int column, int nCopies, GoiPopulationStats *population);
+
+RleWorld *createRleWorld(void)
+{
+    return calloc(1, sizeof(RleWorld));
+}
+
+void freeRleWorld(RleWorld *world)
+{
+    if (world == NULL)
+    {
+        return;
+    }
+    freeRunRows(world->rows, world->nRows);
+    freeRunRows(world->nextRows, world->nRows);
+    for (int i = 0; i < world->nPlans; i++)
+    {
+        freeRunRows(world->plans[i], world->nRows);
+    }
+    free(world->plans);
+    for (int i = 0; i < world->nScratch; i++)
+    {
+        Scratch *scratch = &world->scratch[i];
+        free(scratch->above);
+        free(scratch->row);
+        free(scratch->below);
+        free(scratch->invaders);
+        free(scratch->next);
+        free(scratch->widths);
+    }
+    free(world->scratch);
+    free(world);
+}
+
+/**
+ * Replaces the contents of world with the nRows x nCols layout, and encodes the nInvasions invasion plans
+ * (each nRows x nCols) as runs too. -1 is returned if out of memory.
+ */
+int loadRleWorld(RleWorld *world, const int *layout, int nRows, int nCols, int nInvasions, int **invasionPlans)
+{
+    freeRunRows(world->rows, world->nRows);
+    freeRunRows(world->nextRows, world->nRows);
+    for (int i = 0; i < world->nPlans; i++)
+    {
+        freeRunRows(world->plans[i], world->nRows);
+    }
+    free(world->plans);
+    world->nRows = nRows;
+    world->nCols = nCols;
+    world->nPlans = 0;
+    world->rows = calloc(nRows, sizeof(RunRow));
+    world->nextRows = calloc(nRows, sizeof(RunRow));
+    world->plans = calloc(nInvasions > 0 ? nInvasions : 1, sizeof(RunRow *));
+    if (world->rows == NULL || world->nextRows == NULL || world->plans == NULL)
+    {
+        return -1;
+    }
+    for (; world->nPlans < nInvasions; world->nPlans++)
+    {
+        world->plans[world->nPlans] = calloc(nRows, sizeof(RunRow));
+        if (world->plans[world->nPlans] == NULL ||
+            encodeRows(world->plans[world->nPlans], invasionPlans[world->nPlans], nRows, nCols) == -1)
+        {
+            world->nPlans++;
+            return -1;
+        }
+    }
+    return encodeRows(world->rows, layout, nRows, nCols);
+}
+
+/**
+ * Advances world by one generation, with the invasion plan of index invasion (as passed to loadRleWorld)
+ * landing during it, or none if invasion is -1. If population is not NULL, rowKernel must count all of
+ * COUNT_ALL, and the population of the rows computed is added to population.
+ * Hardware counters sampled during the kernel are added to perfCounts, unless it is NULL.
+ *
+ * Returns the number of deaths due to fighting, or -1 if out of memory, in which case world may only be freed.
+ */
+long stepRleWorld(RleWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live, int invasion,
+                  GoiPopulationStats *population, int nThreads, PerfCounts *perfCounts)
+{
+    if (reserveScratch(world, nThreads) == -1)
+    {
+        return -1;
+    }
+    const RunRow *plan = invasion >= 0 ? world->plans[invasion] : NULL;
+
+    long deathToll = 0;
+    bool failed = false;
+    #pragma omp parallel num_threads(nThreads) reduction(+:deathToll)
+    {
+        GoiPopulationStats threadPopulation = {0};
+        Scratch *scratch = &world->scratch[omp_get_thread_num()];
+        PROFILE_THREAD_START();
+        PERF_THREAD_START();
+        // rows cost as much as their runs, which vary far more than the rows of a dense world
+        #pragma omp for schedule(dynamic, 16) nowait
+        for (int row = 0; row < world->nRows; row++)
+        {
+            long deaths = nextRunRow(world, rules, rowKernel, live, plan, row, scratch, &threadPopulation);
+            if (deaths == -1)
+            {
+                #pragma omp atomic write
+                failed = true;
+            }
+            else
+            {
+                deathToll += deaths;
+            }
+        }
+        PERF_THREAD_STOP(perfCounts);
+        PROFILE_THREAD_END();
+        if (population != NULL)
+        {
+            #pragma omp critical
+            addPopulation(population, &threadPopulation);
+        }
+    }
+    if (failed)
+    {
+        return -1;
+    }
+
+    RunRow *rows = world->rows;
+    world->rows = world->nextRows;
+    world->nextRows = rows;
+    return deathToll;
+}
+
+/**
+ * Writes the nRows x nCols cells of world into layout.
+ */
+void copyRleWorld(const RleWorld *world, int *layout)
+{
+    memset(layout, 0, sizeof(int) * world->nRows * world->nCols);
+    for (int row = 0; row < world->nRows; row++)
+    {
+        int *cells = layout + (long) row * world->nCols;
+        const RunRow *runs = &world->rows[row];
+        for (int i = 0; i < runs->nRuns; i++)
+        {
+            const Run *run = &runs->runs[i];
+            for (int col = run->start; col < run->start + run->length; col++)
+            {
+                cells[col] = run->faction;
+            }
+        }
+    }
+}
+
+/**
+ * Returns the number of runs currently stored.
+ */
+long countRleRuns(const RleWorld *world)
+{
+    long nRuns = 0;
+    for (int row = 0; row < world->nRows; row++)
+    {
+        nRuns += world->rows[row].nRuns;
+    }
+    return nRuns;
+}
+
+// freeRunRows frees the runs of the nRows rows and rows itself, which may be NULL.
+static void freeRunRows(RunRow *rows, int nRows)
+{
+    if (rows == NULL)
+    {
+        return;
+    }
+    for (int row = 0; row < nRows; row++)
+    {
+        free(rows[row].runs);
+    }
+    free(rows);
+}
+
+// encodeRows sets the nRows rows to the runs of the nRows x nCols layout. -1 is returned if out of memory.
+static int encodeRows(RunRow *rows, const int *layout, int nRows, int nCols)
+{
+    for (int row = 0; row < nRows; row++)
+    {
+        const int *cells = layout + (long) row * nCols;
+        long nRuns = 0;
+        for (int col = 0; col < nCols; col++)
+        {
+            nRuns += cells[col] != DEAD_FACTION && (col == 0 || cells[col] != cells[col - 1]);
+        }
+        rows[row].nRuns = 0;
+        if (reserveRuns(&rows[row], nRuns) == -1)
+        {
+            return -1;
+        }
+        for (int col = 0; col < nCols; col++)
+        {
+            appendRun(&rows[row], col, 1, cells[col]);
+        }
+    }
+    return 0;
+}
+
+// reserveRuns makes room for nRuns runs in row, keeping those it has. -1 is returned if out of memory.
+static int reserveRuns(RunRow *row, long nRuns)
+{
+    if (nRuns <= row->capacity)
+    {
+        return 0;
+    }
+    long capacity = 2 * (long) row->capacity > nRuns ? 2 * (long) row->capacity : nRuns;
+    Run *grown = realloc(row->runs, sizeof(Run) * capacity);
+    if (grown == NULL)
+    {
+        return -1;
+    }
+    row->runs = grown;
+    row->capacity = (int) capacity;
+    return 0;
+}
+
+// appendRun adds length cells of faction from start, right of every run in row, joining them to the last run
+// if they carry it on. Dead cells are dropped. row must have room for one more run.
+static void appendRun(RunRow *row, int start, int length, int faction)
+{
+    if (faction == DEAD_FACTION)
+    {
+        return;
+    }
+    Run *last = row->nRuns > 0 ? &row->runs[row->nRuns - 1] : NULL;
+    if (last != NULL && last->faction == faction && last->start + last->length == start)
+    {
+        last->length += length;
+        return;
+    }
+    row->runs[row->nRuns++] = (Run) {start, length, faction};
+}
+
+// reserveScratch makes sure there is a Scratch for each of nThreads threads. -1 is returned if out of memory.
+static int reserveScratch(RleWorld *world, int nThreads)
+{
+    if (nThreads <= world->nScratch)
+    {
+        return 0;
+    }
+    Scratch *grown = realloc(world->scratch, sizeof(Scratch) * nThreads);
+    if (grown == NULL)
+    {
+        return -1;
+    }
+    memset(grown + world->nScratch, 0, sizeof(Scratch) * (nThreads - world->nScratch));
+    world->scratch = grown;
+    world->nScratch = nThreads;
+    return 0;
+}
+
+// growScratch makes room in scratch for a compressed row of nColumns columns. -1 is returned if out of memory.
+static int growScratch(Scratch *scratch, long nColumns)
+{
+    if (nColumns + 2 <= scratch->capacity)
+    {
+        return 0;
+    }
+    int capacity = (int) (nColumns + 2);
+    int **arrays[] = {&scratch->above, &scratch->row, &scratch->below, &scratch->invaders, &scratch->next, &scratch->widths};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+    {
+        int *grown = realloc(*arrays[i], sizeof(int) * capacity);
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        *arrays[i] = grown;
+    }
+    scratch->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Computes row of the next generation into world->nextRows from the current generation's row and its
+ * neighbours, with the invaders of plan (or none if plan is NULL). population is passed on to rowKernel.
+ *
+ * Returns the number of cells in the row that died due to fighting, or -1 if out of memory.
+ */
+static long nextRunRow(RleWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live, const RunRow *plan,
+                       int row, Scratch *scratch, GoiPopulationStats *population)
+{
+    const RunRow *above = row > 0 ? &world->rows[row - 1] : &noRuns;
+    const RunRow *own = &world->rows[row];
+    const RunRow *below = row < world->nRows - 1 ? &world->rows[row + 1] : &noRuns;
+    const RunRow *invaders = plan != NULL ? &plan[row] : &noRuns;
+    RunRow *next = &world->nextRows[row];
+    next->nRuns = 0;
+
+    // with nothing alive around it and nobody landing, the row stays dead
+    long nRuns = (long) above->nRuns + own->nRuns + below->nRuns + invaders->nRuns;
+    if (nRuns == 0)
+    {
+        return 0;
+    }
+
+    // each run starts and ends at most one interval, and an interval takes at most 3 columns; every column
+    // expands to at most one run
+    long maxColumns = 3 * (2 * nRuns + 1);
+    maxColumns = maxColumns < world->nCols ? maxColumns : world->nCols;
+    if (growScratch(scratch, maxColumns) == -1 || reserveRuns(next, maxColumns) == -1)
+    {
+        return -1;
+    }
+
+    int nColumns = compressRows(world->nCols, above, own, below, invaders, scratch);
+    long deaths = rowKernel(rules, live, scratch->above + 1, scratch->row + 1, scratch->below + 1,
+                            invaders->nRuns > 0 ? scratch->invaders + 1 : NULL, scratch->next + 1, nColumns, population);
+
+    int col = 0;
+    for (int column = 1; column <= nColumns; column++)
+    {
+        int width = scratch->widths[column];
+        if (width > 1)
+        {
+            // the kernel counted the interior of the interval once; count the rest of it
+            deaths += repeatCell(rules, scratch, column, width - 1, population);
+        }
+        appendRun(next, col, width, scratch->next[column]);
+        col += width;
+    }
+    return deaths;
+}
+
+// compressRows merges the runs of the four rows into the compressed row of scratch, which must have room for
+// it, and returns its number of columns.
+static int compressRows(int nCols, const RunRow *above, const RunRow *row, const RunRow *below, const RunRow *invaders,
+                        Scratch *scratch)
+{
+    Cursor cursors[4] = {
+        {above->runs, above->runs + above->nRuns},
+        {row->runs, row->runs + row->nRuns},
+        {below->runs, below->runs + below->nRuns},
+        {invaders->runs, invaders->runs + invaders->nRuns},
+    };
+    int *planes[4] = {scratch->above, scratch->row, scratch->below, scratch->invaders};
+
+    int nColumns = 0;
+    for (int col = 0; col < nCols;)
+    {
+        // the interval from col to the first change in any of the rows
+        int end = nCols;
+        int values[4];
+        for (int i = 0; i < 4; i++)
+        {
+            values[i] = cursorValue(&cursors[i], col, &end);
+        }
+
+        // its edge columns and one interior column, which stands for the whole interior
+        int length = end - col;
+        int nCopies = length < 3 ? length : 3;
+        for (int copy = 0; copy < nCopies; copy++)
+        {
+            nColumns++;
+            for (int i = 0; i < 4; i++)
+            {
+                planes[i][nColumns] = values[i];
+            }
+            scratch->widths[nColumns] = 1;
+        }
+        if (length > 3)
+        {
+            scratch->widths[nColumns - 1] = length - 2;
+        }
+        col = end;
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        planes[i][0] = DEAD_FACTION;
+        planes[i][nColumns + 1] = DEAD_FACTION;
+    }
+    return nColumns;
+}
+
+// cursorValue returns the faction of the cell at col, which must not be left of any asked for before, and
+// lowers end to the column where that faction stops, if that is sooner.
+static int cursorValue(Cursor *cursor, int col, int *end)
+{
+    while (cursor->run < cursor->end && cursor->run->start + cursor->run->length <= col)
+    {
+        cursor->run++;
+    }
+    if (cursor->run == cursor->end)
+    {
+        return DEAD_FACTION;
+    }
+    int stop = col < cursor->run->start ? cursor->run->start : cursor->run->start + cursor->run->length;
+    *end = stop < *end ? stop : *end;
+    return col < cursor->run->start ? DEAD_FACTION : cursor->run->faction;
+}
+
+// repeatCell accounts for nCopies more cells like the interior column of the compressed row of scratch,
+// whose next state the kernel has computed and whose neighbours on either side are the same as itself. The
+// cells are added to population, if not NULL, as the COUNT_ALL kernels would. Returns how many of them died
+// due to fighting.
+static long repeatCell(const RuleTable *rules, const Scratch *scratch, int column, int nCopies, GoiPopulationStats *population)
+{
+    int own = scratch->row[column];
+    int next = scratch->next[column];
+    int invader = scratch->invaders[column];
+    bool landed = invader != DEAD_FACTION && (rules->invasionPolicy == GOI_INVASION_OVERRIDE || own == DEAD_FACTION);
+
+    bool fought = false;
+    if (landed)
+    {
+        fought = own != DEAD_FACTION;
+    }
+    else if (own != DEAD_FACTION)
+    {
+        // 3 neighbours above, 3 below and 2 beside, which are of the cell's own faction
+        int above = scratch->above[column];
+        int below = scratch->below[column];
+        int friendly = 2 + 3 * (above == own) + 3 * (below == own);
+        int hostile = 3 * (above != DEAD_FACTION && above != own) + 3 * (below != DEAD_FACTION && below != own);
+        fought = (rules->liveNext[own][friendly][hostile] & FIGHT_FLAG) != 0;
+    }
+
+    if (population != NULL)
+    {
+        population->live[next] += nCopies;
+        if (landed)
+        {
+            population->landed[next] += nCopies;
+            population->fightingDeaths[own] += fought ? nCopies : 0;
+        }
+        else if (next != own)
+        {
+            if (own == DEAD_FACTION)
+            {
+                population->births[next] += nCopies;
+            }
+            else if (fought)
+            {
+                population->fightingDeaths[own] += nCopies;
+            }
+            else
+            {
+                population->naturalDeaths[own] += nCopies;
+            }
+        }
+    }
+    return fought ? nCopies : 0;
+}
@@ -0,0 +1,18 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stdbool.h>
+#include "kernels.h"
+#include "perfcounters.h"
+
+typedef struct RleWorld RleWorld;
+
+RleWorld *createRleWorld(void);
+void freeRleWorld(RleWorld *world);
+int loadRleWorld(RleWorld *world, const int *layout, int nRows, int nCols, int nInvasions, int **invasionPlans);
+long stepRleWorld(RleWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live, int invasion,
+                  GoiPopulationStats *population, int nThreads, PerfCounts *perfCounts);
+void copyRleWorld(const RleWorld *world, int *layout);
+long countRleRuns(const RleWorld *world);
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "rules.h"
+
+static int parseCounts(const char *p, const char *end, int min, unsigned *mask);
+
+/**
+ * Fills rules with the standard rules: birth on exactly 3, survival on 2 or 3, death by fighting next to
+ * any hostile neighbour, and invaders overriding whatever they land on.
+ */
+void goi_default_rules(GoiRules *rules)
+{
+    rules->birthMask = 1u << 3;
+    rules->survivalMask = (1u << 2) | (1u << 3);
+    rules->fightThreshold = 1;
+    rules->invasionPolicy = GOI_INVASION_OVERRIDE;
+}
+
+/**
+ * Parses a rule set written as '/'-separated fields, each starting with a letter:
+ *   B<counts>  friendly neighbour counts (1-8) at which a dead cell is born, e.g. B36
+ *   S<counts>  friendly neighbour counts (0-8) at which a live cell survives, e.g. S23
+ *   F<n>       hostile neighbour count from which a live cell dies fighting, e.g. F1
+ *   I<policy>  what invaders do: "override" (land everywhere) or "vacant" (land on dead cells only)
+ *
+ * Fields that are left out keep their value in rules, so "B36/S23" only changes birth and survival.
+ * -1 is returned, and rules left untouched, if spec is malformed.
+ */
+int goi_parse_rules(const char *spec, GoiRules *rules)
+{
+    GoiRules parsed = *rules;
+    const char *p = spec;
+    while (*p != '\0')
+    {
+        const char *end = strchr(p, '/');
+        if (end == NULL)
+        {
+            end = p + strlen(p);
+        }
+
+        char field = toupper((unsigned char) *p);
+        const char *value = p + 1;
+        int length = end - value;
+        if (field == 'B')
+        {
+            if (parseCounts(value, end, 1, &parsed.birthMask) == -1)
+            {
+                return -1;
+            }
+        }
+        else if (field == 'S')
+        {
+            if (parseCounts(value, end, 0, &parsed.survivalMask) == -1)
+            {
+                return -1;
+            }
+        }
+        else if (field == 'F')
+        {
+            if (length < 1 || length > 2 || !isdigit((unsigned char) value[0]) || (length == 2 && !isdigit((unsigned char) value[1])))
+            {
+                return -1;
+            }
+            parsed.fightThreshold = atoi(value);
+            if (parsed.fightThreshold < 1)
+            {
+                return -1;
+            }
+        }
+        else if (field == 'I')
+        {
+            if (length == 8 && strncmp(value, "override", 8) == 0)
+            {
+                parsed.invasionPolicy = GOI_INVASION_OVERRIDE;
+            }
+            else if (length == 6 && strncmp(value, "vacant", 6) == 0)
+            {
+                parsed.invasionPolicy = GOI_INVASION_VACANT;
+            }
+            else
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            return -1;
+        }
+
+        p = *end == '/' ? end + 1 : end;
+    }
+
+    *rules = parsed;
+    return 0;
+}
+
+/**
+ * Compiles rules into table.
+ */
+void compileRules(const GoiRules *rules, RuleTable *table)
+{
+    memset(table, 0, sizeof(RuleTable));
+
+    for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    {
+        for (int friendly = 0; friendly <= MAX_NEIGHBORS; friendly++)
+        {
+            for (int hostile = 0; hostile + friendly <= MAX_NEIGHBORS; hostile++)
+            {
+                uint8_t next;
+                if (hostile >= rules->fightThreshold)
+                {
+                    next = DEAD_FACTION | FIGHT_FLAG;
+                }
+                else if (rules->survivalMask & (1u << friendly))
+                {
+                    next = faction;
+                }
+                else
+                {
+                    next = DEAD_FACTION;
+                }
+                table->liveNext[faction][friendly][hostile] = next;
+            }
+        }
+    }
+
+    table->birthCounts = rules->birthMask & ((1u << (MAX_NEIGHBORS + 1)) - 1);
+    table->survivalCounts = rules->survivalMask & ((1u << (MAX_NEIGHBORS + 1)) - 1);
+    table->fightThreshold = rules->fightThreshold;
+
+    for (int count = 0; count <= LANE_MASK; count++)
+    {
+        table->birthable[count] = count <= MAX_NEIGHBORS && (rules->birthMask & (1u << count)) != 0;
+    }
+
+    for (int candidates = 0; candidates < (1 << MAX_FACTIONS); candidates++)
+    {
+        int faction = DEAD_FACTION;
+        for (int f = DEAD_FACTION + 1; f < MAX_FACTIONS; f++)
+        {
+            if (candidates & (1 << f))
+            {
+                faction = f;
+            }
+        }
+        table->birthFaction[candidates] = faction;
+    }
+
+    table->invasionPolicy = rules->invasionPolicy;
+}
+
+// parseCounts parses a run of digits in [p, end), each at least min and at most MAX_NEIGHBORS, into a bit mask.
+// -1 is returned on error.
+static int parseCounts(const char *p, const char *end, int min, unsigned *mask)
+{
+    unsigned parsed = 0;
+    for (; p < end; p++)
+    {
+        if (!isdigit((unsigned char) *p) || *p - '0' < min || *p - '0' > MAX_NEIGHBORS)
+        {
+            return -1;
+        }
+        parsed |= 1u << (*p - '0');
+    }
+    *mask = parsed;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+#include "goi.h"
+
+// including the "dead faction": 0
+#define MAX_FACTIONS GOI_MAX_FACTIONS
+
+// this macro is here to make the code slightly more readable, not because it can be safely changed to
+// any integer value; changing this to a non-zero value may break the code
+#define DEAD_FACTION 0
+
+// most neighbours a cell can have
+#define MAX_NEIGHBORS 8
+
+// set in a liveNext entry when the cell dies due to fighting
+#define FIGHT_FLAG 0x80
+
+/**
+ * Per-faction neighbour counts are packed as one 4-bit lane per faction, faction f in bits [4f, 4f + 4).
+ * Adding ONE_HOT(cell) for each of a cell's neighbours counts them all at once, without a memset or a
+ * branch; a lane never exceeds 9, so lanes never carry into each other.
+ */
+#define LANE_BITS 4
+#define LANE_MASK 0xf
+#define ONE_HOT(faction) (1ULL << (LANE_BITS * (faction)))
+#define LANE(counts, faction) ((int) (((counts) >> (LANE_BITS * (faction))) & LANE_MASK))
+
+/**
+ * A GoiRules set compiled into dense lookup tables, so that the next state of a cell is a handful of loads.
+ */
+typedef struct
+{
+    // [own faction][friendly count][hostile count] -> next state of a live cell, or'ed with FIGHT_FLAG if it
+    // died due to fighting. The DEAD_FACTION plane is all DEAD_FACTION.
+    uint8_t liveNext[MAX_FACTIONS][MAX_NEIGHBORS + 1][MAX_NEIGHBORS + 1];
+    // [count] -> 1 if a dead cell with count neighbours of one faction can be born into that faction
+    uint8_t birthable[LANE_MASK + 1];
+    // [bit mask of factions that can be born] -> the faction a dead cell becomes (the highest candidate wins)
+    uint8_t birthFaction[1 << MAX_FACTIONS];
+    // the same rules as masks, for kernels that decide many cells at once: bit n is set in birthCounts if a
+    // count of n is birthable, and in survivalCounts if n friendly neighbours let a cell survive
+    uint16_t birthCounts;
+    uint16_t survivalCounts;
+    int fightThreshold;
+    GoiInvasionPolicy invasionPolicy;
+} RuleTable;
+
+void compileRules(const GoiRules *rules, RuleTable *table);
+
+#endif
@@ -29,4 +29,32 @@
  */
 #define PRINT_GENERATIONS 0
 
+/**
+ * If set to 0, does nothing and the profiling hooks compile away entirely.
+ * 
+ * If set to a non-zero value, times each phase of a run (input parsing, world init, invasion copy, kernel,
+ * buffer swap/free, export and output write) as well as the time each thread spends in the kernel, and
+ * prints a summary table to standard error when the program exits.
+ * 
+ * The per-thread kernel times are measured up to each thread's arrival at the end-of-generation barrier,
+ * so uneven numbers point at load imbalance. In a batch, the jobs packed onto one thread of the batch count
+ * towards that thread.
+ */
+#define PROFILE_PHASES 0
+
+/**
+ * If set to 0, does nothing and the counter hooks compile away entirely.
+ * 
+ * If set to a non-zero value, every simulation thread samples its hardware performance counters (cycles,
+ * instructions, last-level cache misses and dTLB misses) through perf_event_open while it runs the kernel.
+ * Counts are summed over windows of generations and printed to standard error, with IPC and an estimate
+ * of memory bandwidth from the cache misses. The window length in generations is read from the
+ * GOI_PERF_WINDOW environment variable and defaults to 100. A run that ends partway through a window reports
+ * what is left of it when its context is reset or destroyed. Batches run with --ensemble are not sampled.
+ * 
+ * Where counters cannot be opened (e.g. inside a container, or with a restrictive perf_event_paranoid),
+ * a single warning is printed and the simulation runs as normal.
+ */
+#define SAMPLE_PERF_COUNTERS 0
+
 #endif
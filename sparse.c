@@ -0,0 +1,554 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "sparse.h"
+#include "profile.h"
+#include "perfcounters.h"
+#include <omp.h>
+
+/**
+ * The sparse engine: the plane is cut into CHUNK_SIZE x CHUNK_SIZE chunks and only chunks with live cells are
+ * stored, in a hash table keyed by chunk position. Each generation visits every stored chunk plus every absent
+ * chunk that activity on a stored chunk's border, or an invasion, has reached; nothing can be born anywhere
+ * else, as an all-dead neighbourhood stays dead. Chunks that die out are dropped. Work and memory therefore
+ * scale with the live area rather than with the bounds of the world.
+ *
+ * A bounded world clips chunks to [0, nRows) x [0, nCols), so cells beyond it stay dead as in the dense
+ * engines. An unbounded one lets the same rules play out past the bounds; the bounds then only place the
+ * start world and invasions, and frame goi_world.
+ */
+
+#define CHUNK_BITS 6
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+
+// a chunk with a one-cell border borrowed from its neighbours, as the row kernels expect
+#define TILE_SIZE (CHUNK_SIZE + 2)
+
+// bit (dr + 1) * 3 + (dc + 1) of Chunk.edges: activity has reached the neighbouring chunk at (dr, dc)
+#define EDGE_BIT(dr, dc) (1u << (((dr) + 1) * 3 + (dc) + 1))
+
+typedef struct
+{
+    long chunkRow;
+    long chunkCol;
+    bool alive;
+    unsigned edges;
+    int cells[CHUNK_SIZE * CHUNK_SIZE];
+} Chunk;
+
+/**
+ * Open-addressed hash table of chunks by position, with linear probing. Chunks are only ever added; the
+ * whole table is cleared instead, once per generation.
+ */
+typedef struct
+{
+    Chunk **slots;
+    long capacity; // a power of two, or 0
+    long count;
+} ChunkTable;
+
+typedef struct
+{
+    Chunk **items;
+    long count;
+    long capacity;
+} ChunkList;
+
+struct SparseWorld
+{
+    int nRows;
+    int nCols;
+    bool bounded;
+    ChunkTable table;     // the chunks of the current generation...
+    ChunkList chunks;     // ...and the same, for iteration
+    ChunkTable pending;   // the chunks of the generation being computed, while its work is gathered...
+    ChunkList candidates; // ...and the same, for iteration
+    ChunkList pool;       // chunks not in use, kept for reuse
+};
+
+static Chunk *findChunk(const ChunkTable *table, long chunkRow, long chunkCol);
+static int insertChunk(ChunkTable *table, Chunk *chunk);
+static void clearTable(ChunkTable *table);
+static int pushChunk(ChunkList *list, Chunk *chunk);
+static Chunk *acquireChunk(SparseWorld *world, long chunkRow, long chunkCol);
+static void recycleChunk(SparseWorld *world, Chunk *chunk);
+static void releaseChunks(SparseWorld *world, ChunkList *list);
+static int addCandidate(SparseWorld *world, long chunkRow, long chunkCol);
+static bool hasInvaders(const SparseWorld *world, const int *invasionPlan, long chunkRow, long chunkCol);
+static long nextChunk(const SparseWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live,
+                      const int *invasionPlan, Chunk *next, GoiPopulationStats *population);
+static void findEdges(Chunk *chunk);
+static int chunkExtent(long chunkIndex, int bound, bool bounded);
+
+SparseWorld *createSparseWorld(void)
+{
+    return calloc(1, sizeof(SparseWorld));
+}
+
+void freeSparseWorld(SparseWorld *world)
+{
+    if (world == NULL)
+    {
+        return;
+    }
+    releaseChunks(world, &world->chunks);
+    releaseChunks(world, &world->candidates);
+    for (long i = 0; i < world->pool.count; i++)
+    {
+        free(world->pool.items[i]);
+    }
+    free(world->pool.items);
+    free(world->chunks.items);
+    free(world->candidates.items);
+    free(world->table.slots);
+    free(world->pending.slots);
+    free(world);
+}
+
+/**
+ * Replaces the contents of world with the nRows x nCols layout, keeping only the chunks of it that have live
+ * cells. -1 is returned if out of memory.
+ */
+int loadSparseWorld(SparseWorld *world, const int *layout, int nRows, int nCols, bool bounded)
+{
+    releaseChunks(world, &world->chunks);
+    clearTable(&world->table);
+    world->nRows = nRows;
+    world->nCols = nCols;
+    world->bounded = bounded;
+
+    for (long chunkRow = 0; chunkRow * CHUNK_SIZE < nRows; chunkRow++)
+    {
+        for (long chunkCol = 0; chunkCol * CHUNK_SIZE < nCols; chunkCol++)
+        {
+            Chunk *chunk = acquireChunk(world, chunkRow, chunkCol);
+            if (chunk == NULL)
+            {
+                return -1;
+            }
+            memset(chunk->cells, 0, sizeof(chunk->cells));
+            int nChunkRows = chunkExtent(chunkRow, nRows, true);
+            int nChunkCols = chunkExtent(chunkCol, nCols, true);
+            for (int row = 0; row < nChunkRows; row++)
+            {
+                memcpy(chunk->cells + row * CHUNK_SIZE, layout + (chunkRow * CHUNK_SIZE + row) * nCols + chunkCol * CHUNK_SIZE,
+                       sizeof(int) * nChunkCols);
+            }
+
+            findEdges(chunk);
+            if (!chunk->alive)
+            {
+                recycleChunk(world, chunk);
+            }
+            else if (pushChunk(&world->chunks, chunk) == -1)
+            {
+                recycleChunk(world, chunk);
+                return -1;
+            }
+            else if (insertChunk(&world->table, chunk) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Advances world by one generation, with invasionPlan (nRows x nCols, or NULL) landing during it. If
+ * population is not NULL, rowKernel counts the population of the chunks it computes into it.
+ * Hardware counters sampled during the kernel are added to perfCounts, unless it is NULL.
+ *
+ * Returns the number of deaths due to fighting, or -1 if out of memory, in which case world may only be freed.
+ */
+long stepSparseWorld(SparseWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live,
+                     const int *invasionPlan, GoiPopulationStats *population, int nThreads, PerfCounts *perfCounts)
+{
+    // gather the chunks to compute: every live one, every absent one their activity has reached, and every
+    // one an invasion lands in
+    clearTable(&world->pending);
+    for (long i = 0; i < world->chunks.count; i++)
+    {
+        Chunk *chunk = world->chunks.items[i];
+        if (addCandidate(world, chunk->chunkRow, chunk->chunkCol) == -1)
+        {
+            return -1;
+        }
+    }
+    for (long i = 0; i < world->chunks.count; i++)
+    {
+        Chunk *chunk = world->chunks.items[i];
+        for (int dr = -1; dr <= 1; dr++)
+        {
+            for (int dc = -1; dc <= 1; dc++)
+            {
+                if ((chunk->edges & EDGE_BIT(dr, dc)) && addCandidate(world, chunk->chunkRow + dr, chunk->chunkCol + dc) == -1)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    if (invasionPlan != NULL)
+    {
+        for (long chunkRow = 0; chunkRow * CHUNK_SIZE < world->nRows; chunkRow++)
+        {
+            for (long chunkCol = 0; chunkCol * CHUNK_SIZE < world->nCols; chunkCol++)
+            {
+                if (hasInvaders(world, invasionPlan, chunkRow, chunkCol) && addCandidate(world, chunkRow, chunkCol) == -1)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    long deathToll = 0;
+    long nCandidates = world->candidates.count;
+    #pragma omp parallel num_threads(nThreads) reduction(+:deathToll)
+    {
+        GoiPopulationStats threadPopulation = {0};
+        PROFILE_THREAD_START();
+        PERF_THREAD_START();
+        #pragma omp for nowait
+        for (long i = 0; i < nCandidates; i++)
+        {
+            deathToll += nextChunk(world, rules, rowKernel, live, invasionPlan, world->candidates.items[i], &threadPopulation);
+        }
+        PERF_THREAD_STOP(perfCounts);
+        PROFILE_THREAD_END();
+        if (population != NULL)
+        {
+            #pragma omp critical
+            addPopulation(population, &threadPopulation);
+        }
+    }
+
+    // the candidates that still have live cells are the new generation
+    releaseChunks(world, &world->chunks);
+    clearTable(&world->table);
+    for (long i = 0; i < nCandidates; i++)
+    {
+        Chunk *chunk = world->candidates.items[i];
+        if (!chunk->alive)
+        {
+            recycleChunk(world, chunk);
+        }
+        else if (insertChunk(&world->table, chunk) == -1 || pushChunk(&world->chunks, chunk) == -1)
+        {
+            return -1;
+        }
+    }
+    world->candidates.count = 0;
+    return deathToll;
+}
+
+/**
+ * Writes the nRows x nCols cells inside the bounds of world into layout.
+ */
+void copySparseWorld(const SparseWorld *world, int *layout)
+{
+    int nRows = world->nRows;
+    int nCols = world->nCols;
+    memset(layout, 0, sizeof(int) * nRows * nCols);
+    for (long i = 0; i < world->chunks.count; i++)
+    {
+        const Chunk *chunk = world->chunks.items[i];
+        if (chunk->chunkRow < 0 || chunk->chunkRow * CHUNK_SIZE >= nRows || chunk->chunkCol < 0 || chunk->chunkCol * CHUNK_SIZE >= nCols)
+        {
+            continue;
+        }
+        int nChunkRows = chunkExtent(chunk->chunkRow, nRows, true);
+        int nChunkCols = chunkExtent(chunk->chunkCol, nCols, true);
+        for (int row = 0; row < nChunkRows; row++)
+        {
+            memcpy(layout + (chunk->chunkRow * CHUNK_SIZE + row) * nCols + chunk->chunkCol * CHUNK_SIZE, chunk->cells + row * CHUNK_SIZE,
+                   sizeof(int) * nChunkCols);
+        }
+    }
+}
+
+/**
+ * Returns the number of chunks currently stored.
+ */
+long countSparseChunks(const SparseWorld *world)
+{
+    return world->chunks.count;
+}
+
+// findChunk returns the chunk at the position, or NULL if there is none.
+static Chunk *findChunk(const ChunkTable *table, long chunkRow, long chunkCol)
+{
+    if (table->capacity == 0)
+    {
+        return NULL;
+    }
+    uint64_t key = (uint64_t) (uint32_t) chunkRow << 32 | (uint32_t) chunkCol;
+    long mask = table->capacity - 1;
+    for (long slot = (key * 0x9e3779b97f4a7c15ULL) >> 32 & mask;; slot = (slot + 1) & mask)
+    {
+        Chunk *chunk = table->slots[slot];
+        if (chunk == NULL || (chunk->chunkRow == chunkRow && chunk->chunkCol == chunkCol))
+        {
+            return chunk;
+        }
+    }
+}
+
+// insertChunk adds a chunk that is not yet in the table, growing it to stay at most half full.
+// -1 is returned if out of memory.
+static int insertChunk(ChunkTable *table, Chunk *chunk)
+{
+    if (2 * (table->count + 1) > table->capacity)
+    {
+        ChunkTable grown = {.capacity = table->capacity == 0 ? 64 : 2 * table->capacity};
+        grown.slots = calloc(grown.capacity, sizeof(Chunk *));
+        if (grown.slots == NULL)
+        {
+            return -1;
+        }
+        for (long slot = 0; slot < table->capacity; slot++)
+        {
+            if (table->slots[slot] != NULL)
+            {
+                insertChunk(&grown, table->slots[slot]);
+            }
+        }
+        free(table->slots);
+        *table = grown;
+    }
+
+    uint64_t key = (uint64_t) (uint32_t) chunk->chunkRow << 32 | (uint32_t) chunk->chunkCol;
+    long mask = table->capacity - 1;
+    long slot = (key * 0x9e3779b97f4a7c15ULL) >> 32 & mask;
+    while (table->slots[slot] != NULL)
+    {
+        slot = (slot + 1) & mask;
+    }
+    table->slots[slot] = chunk;
+    table->count++;
+    return 0;
+}
+
+static void clearTable(ChunkTable *table)
+{
+    if (table->count > 0)
+    {
+        memset(table->slots, 0, sizeof(Chunk *) * table->capacity);
+        table->count = 0;
+    }
+}
+
+// pushChunk appends to list, growing it as needed. -1 is returned if out of memory.
+static int pushChunk(ChunkList *list, Chunk *chunk)
+{
+    if (list->count == list->capacity)
+    {
+        long capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+        Chunk **grown = realloc(list->items, sizeof(Chunk *) * capacity);
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = chunk;
+    return 0;
+}
+
+// acquireChunk returns a chunk for the position, reused from the pool if possible. Its cells are not cleared.
+// NULL is returned if out of memory.
+static Chunk *acquireChunk(SparseWorld *world, long chunkRow, long chunkCol)
+{
+    Chunk *chunk = world->pool.count > 0 ? world->pool.items[--world->pool.count] : malloc(sizeof(Chunk));
+    if (chunk != NULL)
+    {
+        chunk->chunkRow = chunkRow;
+        chunk->chunkCol = chunkCol;
+    }
+    return chunk;
+}
+
+// recycleChunk returns chunk to the pool, or frees it if the pool cannot grow.
+static void recycleChunk(SparseWorld *world, Chunk *chunk)
+{
+    if (pushChunk(&world->pool, chunk) == -1)
+    {
+        free(chunk);
+    }
+}
+
+// releaseChunks recycles every chunk in list and empties list.
+static void releaseChunks(SparseWorld *world, ChunkList *list)
+{
+    for (long i = 0; i < list->count; i++)
+    {
+        recycleChunk(world, list->items[i]);
+    }
+    list->count = 0;
+}
+
+// addCandidate makes sure the chunk at the position is computed this generation, unless it lies outside the
+// bounds of a bounded world. -1 is returned if out of memory.
+static int addCandidate(SparseWorld *world, long chunkRow, long chunkCol)
+{
+    if (world->bounded &&
+        (chunkRow < 0 || chunkRow * CHUNK_SIZE >= world->nRows || chunkCol < 0 || chunkCol * CHUNK_SIZE >= world->nCols))
+    {
+        return 0;
+    }
+    if (findChunk(&world->pending, chunkRow, chunkCol) != NULL)
+    {
+        return 0;
+    }
+
+    Chunk *chunk = acquireChunk(world, chunkRow, chunkCol);
+    if (chunk == NULL)
+    {
+        return -1;
+    }
+    // candidates owns the chunk once it is pushed, so it goes in before the pending table can point at it
+    if (pushChunk(&world->candidates, chunk) == -1)
+    {
+        recycleChunk(world, chunk);
+        return -1;
+    }
+    return insertChunk(&world->pending, chunk);
+}
+
+// hasInvaders returns whether invasionPlan lands anyone in the chunk at the position, which must be inside
+// the bounds.
+static bool hasInvaders(const SparseWorld *world, const int *invasionPlan, long chunkRow, long chunkCol)
+{
+    int nChunkRows = chunkExtent(chunkRow, world->nRows, true);
+    int nChunkCols = chunkExtent(chunkCol, world->nCols, true);
+    for (int row = 0; row < nChunkRows; row++)
+    {
+        const int *cells = invasionPlan + (chunkRow * CHUNK_SIZE + row) * world->nCols + chunkCol * CHUNK_SIZE;
+        int any = 0;
+        for (int col = 0; col < nChunkCols; col++)
+        {
+            any |= cells[col];
+        }
+        if (any != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Computes next, a chunk of the generation being computed, from the current generation around it. Cells of
+ * next beyond the bounds of a bounded world are left dead. population is passed on to rowKernel.
+ *
+ * Returns the number of cells in the chunk that died due to fighting.
+ */
+static long nextChunk(const SparseWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live,
+                      const int *invasionPlan, Chunk *next, GoiPopulationStats *population)
+{
+    int tile[TILE_SIZE * TILE_SIZE];
+    int invaders[CHUNK_SIZE * CHUNK_SIZE];
+    long chunkRow = next->chunkRow;
+    long chunkCol = next->chunkCol;
+
+    // lay the chunk and the facing borders of its 8 neighbours out as one padded tile; absent chunks are dead
+    for (int tileRow = 0; tileRow < TILE_SIZE; tileRow++)
+    {
+        int dr = tileRow == 0 ? -1 : (tileRow == TILE_SIZE - 1 ? 1 : 0);
+        int sourceRow = (tileRow - 1) & (CHUNK_SIZE - 1);
+        int *cells = tile + tileRow * TILE_SIZE;
+        const Chunk *west = findChunk(&world->table, chunkRow + dr, chunkCol - 1);
+        const Chunk *middle = findChunk(&world->table, chunkRow + dr, chunkCol);
+        const Chunk *east = findChunk(&world->table, chunkRow + dr, chunkCol + 1);
+        cells[0] = west != NULL ? west->cells[sourceRow * CHUNK_SIZE + CHUNK_SIZE - 1] : 0;
+        if (middle != NULL)
+        {
+            memcpy(cells + 1, middle->cells + sourceRow * CHUNK_SIZE, sizeof(int) * CHUNK_SIZE);
+        }
+        else
+        {
+            memset(cells + 1, 0, sizeof(int) * CHUNK_SIZE);
+        }
+        cells[TILE_SIZE - 1] = east != NULL ? east->cells[sourceRow * CHUNK_SIZE] : 0;
+    }
+
+    // invasions only ever land inside the bounds
+    int nChunkRows = chunkExtent(chunkRow, world->nRows, world->bounded);
+    int nChunkCols = chunkExtent(chunkCol, world->nCols, world->bounded);
+    const int *inv = NULL;
+    if (invasionPlan != NULL && chunkRow >= 0 && chunkRow * CHUNK_SIZE < world->nRows && chunkCol >= 0 &&
+        chunkCol * CHUNK_SIZE < world->nCols && hasInvaders(world, invasionPlan, chunkRow, chunkCol))
+    {
+        int nPlanRows = chunkExtent(chunkRow, world->nRows, true);
+        int nPlanCols = chunkExtent(chunkCol, world->nCols, true);
+        memset(invaders, 0, sizeof(invaders));
+        for (int row = 0; row < nPlanRows; row++)
+        {
+            memcpy(invaders + row * CHUNK_SIZE, invasionPlan + (chunkRow * CHUNK_SIZE + row) * world->nCols + chunkCol * CHUNK_SIZE,
+                   sizeof(int) * nPlanCols);
+        }
+        inv = invaders;
+    }
+
+    // a clipped chunk may have been reused from anywhere, so clear what the kernel will not write
+    if (nChunkRows < CHUNK_SIZE || nChunkCols < CHUNK_SIZE)
+    {
+        memset(next->cells, 0, sizeof(next->cells));
+    }
+
+    long deaths = 0;
+    for (int row = 0; row < nChunkRows; row++)
+    {
+        const int *centre = tile + (row + 1) * TILE_SIZE + 1;
+        deaths += rowKernel(rules, live, centre - TILE_SIZE, centre, centre + TILE_SIZE, inv != NULL ? inv + row * CHUNK_SIZE : NULL,
+                            next->cells + row * CHUNK_SIZE, nChunkCols, population);
+    }
+
+    findEdges(next);
+    return deaths;
+}
+
+// findEdges sets whether chunk has any live cell, and towards which of its neighbours.
+static void findEdges(Chunk *chunk)
+{
+    const int *cells = chunk->cells;
+    const int *bottom = cells + (CHUNK_SIZE - 1) * CHUNK_SIZE;
+    int any = 0;
+    int top = 0;
+    int left = 0;
+    int right = 0;
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++)
+    {
+        any |= cells[i];
+    }
+    int lower = 0;
+    for (int i = 0; i < CHUNK_SIZE; i++)
+    {
+        top |= cells[i];
+        lower |= bottom[i];
+        left |= cells[i * CHUNK_SIZE];
+        right |= cells[i * CHUNK_SIZE + CHUNK_SIZE - 1];
+    }
+
+    unsigned edges = 0;
+    edges |= top ? EDGE_BIT(-1, 0) : 0;
+    edges |= lower ? EDGE_BIT(1, 0) : 0;
+    edges |= left ? EDGE_BIT(0, -1) : 0;
+    edges |= right ? EDGE_BIT(0, 1) : 0;
+    edges |= cells[0] ? EDGE_BIT(-1, -1) : 0;
+    edges |= cells[CHUNK_SIZE - 1] ? EDGE_BIT(-1, 1) : 0;
+    edges |= bottom[0] ? EDGE_BIT(1, -1) : 0;
+    edges |= bottom[CHUNK_SIZE - 1] ? EDGE_BIT(1, 1) : 0;
+    chunk->alive = any != 0;
+    chunk->edges = edges;
+}
+
+// chunkExtent returns how many rows (or columns) of the chunk at chunkIndex lie inside [0, bound), if bounded,
+// and CHUNK_SIZE otherwise.
+static int chunkExtent(long chunkIndex, int bound, bool bounded)
+{
+    long remaining = bound - chunkIndex * CHUNK_SIZE;
+    return !bounded || remaining >= CHUNK_SIZE ? CHUNK_SIZE : (int) remaining;
+}
@@ -0,0 +1,18 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stdbool.h>
+#include "kernels.h"
+#include "perfcounters.h"
+
+typedef struct SparseWorld SparseWorld;
+
+SparseWorld *createSparseWorld(void);
+void freeSparseWorld(SparseWorld *world);
+int loadSparseWorld(SparseWorld *world, const int *layout, int nRows, int nCols, bool bounded);
+long stepSparseWorld(SparseWorld *world, const RuleTable *rules, RowKernel rowKernel, const LiveFactions *live,
+                     const int *invasionPlan, GoiPopulationStats *population, int nThreads, PerfCounts *perfCounts);
+void copySparseWorld(const SparseWorld *world, int *layout);
+long countSparseChunks(const SparseWorld *world);
+
+#endif
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "tune.h"
+#include "input.h"
+#include "util.h"
+
+/**
+ * The autotuner: short trial runs of an input under different thread counts, schedules, chunk sizes and
+ * column tiles, the winner of which is saved to a tuning cache for later runs to pick up.
+ *
+ * The search goes one setting at a time rather than over every combination: first the thread count, with
+ * the default schedule and whole rows, then the schedule and chunk size with the best thread count, then the
+ * tile width with the best of those. Each trial simulates only as many generations as keep it short.
+ *
+ * The cache is a text file with one line per tuned world size and CPU:
+ *     <rows> <cols> <threads> <schedule> <chunk> <tile> <CPU model>
+ * where the CPU model, which may have spaces in it, runs to the end of the line. Lines starting with # are
+ * comments.
+ */
+
+// cells times generations that a trial simulates, a fraction of a second's work on one thread
+#define TRIAL_CELL_GENERATIONS 10000000L
+#define TRIAL_REPETITIONS 3
+#define CACHE_HEADER "# goi tuning cache: rows cols threads schedule chunk tile cpu-model\n"
+
+static const struct
+{
+    GoiSchedule schedule;
+    int chunkSize;
+} scheduleCandidates[] = {
+    {GOI_SCHEDULE_STATIC, 0},
+    {GOI_SCHEDULE_STATIC, 16},
+    {GOI_SCHEDULE_DYNAMIC, 1},
+    {GOI_SCHEDULE_DYNAMIC, 8},
+    {GOI_SCHEDULE_DYNAMIC, 64},
+    {GOI_SCHEDULE_GUIDED, 0},
+    {GOI_SCHEDULE_GUIDED, 8},
+};
+
+static const int tileCandidates[] = {256, 1024, 4096};
+
+static double runTrial(const GoiInput *input, const GoiOptions *options, const Tuning *tuning, int nGenerations);
+static void printTuning(const Tuning *tuning);
+static int saveTuning(const char *cachePath, int nRows, int nCols, const Tuning *tuning);
+static const char *cpuModel(void);
+
+/**
+ * Tunes the simulation of the input at inputPath with options (whose rules the input's own take precedence
+ * over unless fixedRules is set) on up to maxThreads threads, printing every trial, and saves the winner to
+ * the tuning cache at cachePath, unless cachePath is NULL.
+ *
+ * Only the thread count matters to the sparse and run-length engines, so only it is tuned for them.
+ *
+ * -1 is returned on error.
+ */
+int runTuner(const char *inputPath, const GoiOptions *options, bool fixedRules, int maxThreads, const char *cachePath)
+{
+    FILE *inputFile = fopen(inputPath, "r");
+    if (inputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for reading.\n", inputPath);
+        return -1;
+    }
+    GoiInput input;
+    int ret = readInput(inputFile, &input, options->engine == GOI_ENGINE_MAPPED);
+    fclose(inputFile);
+    if (ret == -1)
+    {
+        fprintf(stderr, "Failed to parse %s.\n", inputPath);
+        return -1;
+    }
+
+    GoiOptions base = *options;
+    if (!fixedRules)
+    {
+        applyInputRules(&input, &base);
+    }
+    long nCells = (long) input.nRows * input.nCols;
+    long nGenerations = TRIAL_CELL_GENERATIONS / nCells;
+    nGenerations = nGenerations < input.nGenerations ? nGenerations : input.nGenerations;
+    nGenerations = nGenerations < 1 ? 1 : nGenerations;
+    printf("Tuning %s (%d x %d) on %s, %ld generations per trial\n", inputPath, input.nRows, input.nCols, cpuModel(), nGenerations);
+
+    Tuning best = {1, GOI_SCHEDULE_STATIC, 0, 0};
+    double bestTime = runTrial(&input, &base, &best, (int) nGenerations);
+    ret = bestTime < 0 ? -1 : 0;
+
+    // thread counts double up to maxThreads, which is always tried
+    for (int nThreads = 2; ret == 0 && nThreads < 2 * maxThreads; nThreads *= 2)
+    {
+        Tuning candidate = best;
+        candidate.nThreads = nThreads < maxThreads ? nThreads : maxThreads;
+        double time = runTrial(&input, &base, &candidate, (int) nGenerations);
+        ret = time < 0 ? -1 : 0;
+        if (ret == 0 && time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+
+    bool dense = base.engine == GOI_ENGINE_DENSE || base.engine == GOI_ENGINE_MAPPED;
+    Tuning threaded = best;
+    for (size_t i = 1; dense && ret == 0 && i < sizeof(scheduleCandidates) / sizeof(scheduleCandidates[0]); i++)
+    {
+        Tuning candidate = threaded;
+        candidate.schedule = scheduleCandidates[i].schedule;
+        candidate.chunkSize = scheduleCandidates[i].chunkSize;
+        double time = runTrial(&input, &base, &candidate, (int) nGenerations);
+        ret = time < 0 ? -1 : 0;
+        if (ret == 0 && time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+
+    Tuning scheduled = best;
+    for (size_t i = 0; dense && ret == 0 && i < sizeof(tileCandidates) / sizeof(tileCandidates[0]); i++)
+    {
+        // a tile as wide as the world is the same as whole rows
+        if (tileCandidates[i] >= input.nCols)
+        {
+            break;
+        }
+        Tuning candidate = scheduled;
+        candidate.tileCols = tileCandidates[i];
+        double time = runTrial(&input, &base, &candidate, (int) nGenerations);
+        ret = time < 0 ? -1 : 0;
+        if (ret == 0 && time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+
+    if (ret == 0)
+    {
+        printf("Best: ");
+        printTuning(&best);
+        printf(": %f s\n", bestTime);
+        if (cachePath != NULL && saveTuning(cachePath, input.nRows, input.nCols, &best) == 0)
+        {
+            printf("Saved to %s\n", cachePath);
+        }
+    }
+    freeInput(&input);
+    return ret;
+}
+
+/**
+ * Looks up the tuning for nRows x nCols worlds on this CPU in the tuning cache at cachePath. -1 is returned
+ * if there is none, or no cache.
+ */
+int loadTuning(const char *cachePath, int nRows, int nCols, Tuning *tuning)
+{
+    FILE *file = fopen(cachePath, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    const char *cpu = cpuModel();
+    char *line = NULL;
+    size_t len = 0;
+    int ret = -1;
+    while (ret == -1 && getline(&line, &len, file) != -1)
+    {
+        int rows;
+        int cols;
+        Tuning entry;
+        char schedule[16];
+        int at;
+        if (line[0] == '#' ||
+            sscanf(line, "%d %d %d %15s %d %d %n", &rows, &cols, &entry.nThreads, schedule, &entry.chunkSize, &entry.tileCols, &at) != 6)
+        {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        if (rows == nRows && cols == nCols && strcmp(line + at, cpu) == 0 && entry.nThreads > 0 &&
+            goi_parse_schedule(schedule, &entry.schedule) == 0)
+        {
+            *tuning = entry;
+            ret = 0;
+        }
+    }
+    free(line);
+    fclose(file);
+    return ret;
+}
+
+/**
+ * Returns the path of the tuning cache: $GOI_TUNE_CACHE if set, or else .goi-tuning in the home directory.
+ * NULL is returned if there is neither.
+ */
+const char *defaultTuningCache(void)
+{
+    static char path[PATH_MAX];
+    const char *env = getenv("GOI_TUNE_CACHE");
+    if (env != NULL && env[0] != '\0')
+    {
+        return env;
+    }
+    const char *home = getenv("HOME");
+    if (home == NULL || home[0] == '\0' || snprintf(path, sizeof(path), "%s/.goi-tuning", home) >= (int) sizeof(path))
+    {
+        return NULL;
+    }
+    return path;
+}
+
+// runTrial prints and returns the best time of a few runs of nGenerations of input under tuning, or -1 if
+// the simulation failed.
+static double runTrial(const GoiInput *input, const GoiOptions *options, const Tuning *tuning, int nGenerations)
+{
+    GoiOptions trialOptions = *options;
+    trialOptions.nThreads = tuning->nThreads;
+    trialOptions.schedule = tuning->schedule;
+    trialOptions.chunkSize = tuning->chunkSize;
+    trialOptions.tileCols = tuning->tileCols;
+    GoiContext *ctx = goi_create(&trialOptions, input->startWorld, input->nRows, input->nCols, input->nInvasions,
+                                 input->invasionTimes, input->invasionPlans);
+    if (ctx == NULL)
+    {
+        fprintf(stderr, "Failed to simulate the input.\n");
+        return -1;
+    }
+
+    double best = -1;
+    for (int i = 0; i < TRIAL_REPETITIONS; i++)
+    {
+        if (goi_reset(ctx, input->startWorld, input->nRows, input->nCols, input->nInvasions, input->invasionTimes,
+                      input->invasionPlans) == -1)
+        {
+            fprintf(stderr, "Failed to simulate the input.\n");
+            best = -1;
+            break;
+        }
+        // only the simulation is timed, as by --bench
+        double start = getWallTime();
+        if (goi_step(ctx, nGenerations) == -1)
+        {
+            fprintf(stderr, "Failed to simulate the input.\n");
+            best = -1;
+            break;
+        }
+        double time = getWallTime() - start;
+        best = best < 0 || time < best ? time : best;
+    }
+    goi_destroy(ctx);
+
+    if (best >= 0)
+    {
+        printf("  ");
+        printTuning(tuning);
+        printf(": %f s\n", best);
+    }
+    return best;
+}
+
+static void printTuning(const Tuning *tuning)
+{
+    printf("%d threads, %s schedule, chunk %d, ", tuning->nThreads, goi_schedule_name(tuning->schedule), tuning->chunkSize);
+    if (tuning->tileCols > 0)
+    {
+        printf("tiles of %d columns", tuning->tileCols);
+    }
+    else
+    {
+        printf("whole rows");
+    }
+}
+
+// saveTuning records tuning for nRows x nCols worlds on this CPU in the tuning cache at cachePath, replacing
+// any earlier tuning for them. The cache is rewritten to a temporary file first, so that a failed write
+// leaves the old one be. -1 is returned on error.
+static int saveTuning(const char *cachePath, int nRows, int nCols, const Tuning *tuning)
+{
+    char tempPath[PATH_MAX];
+    if (snprintf(tempPath, sizeof(tempPath), "%s.tmp", cachePath) >= (int) sizeof(tempPath))
+    {
+        fprintf(stderr, "Tuning cache path %s is too long.\n", cachePath);
+        return -1;
+    }
+    FILE *out = fopen(tempPath, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing.\n", tempPath);
+        return -1;
+    }
+
+    const char *cpu = cpuModel();
+    fputs(CACHE_HEADER, out);
+    FILE *in = fopen(cachePath, "r");
+    if (in != NULL)
+    {
+        char *line = NULL;
+        size_t len = 0;
+        while (getline(&line, &len, in) != -1)
+        {
+            int rows;
+            int cols;
+            int at;
+            if (line[0] == '#')
+            {
+                continue;
+            }
+            // every other size, and every other CPU, is kept as it was
+            if (sscanf(line, "%d %d %*d %*s %*d %*d %n", &rows, &cols, &at) == 2 && rows == nRows && cols == nCols &&
+                strncmp(line + at, cpu, strlen(cpu)) == 0 && strcspn(line + at, "\n") == strlen(cpu))
+            {
+                continue;
+            }
+            fputs(line, out);
+        }
+        free(line);
+        fclose(in);
+    }
+    fprintf(out, "%d %d %d %s %d %d %s\n", nRows, nCols, tuning->nThreads, goi_schedule_name(tuning->schedule), tuning->chunkSize,
+            tuning->tileCols, cpu);
+
+    bool failed = ferror(out);
+    failed |= fclose(out) == EOF;
+    if (failed || rename(tempPath, cachePath) == -1)
+    {
+        fprintf(stderr, "Failed to write %s.\n", cachePath);
+        remove(tempPath);
+        return -1;
+    }
+    return 0;
+}
+
+// cpuModel returns the model name of the CPU from /proc/cpuinfo, or "unknown".
+static const char *cpuModel(void)
+{
+    static char model[256];
+    if (model[0] != '\0')
+    {
+        return model;
+    }
+    strcpy(model, "unknown");
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file == NULL)
+    {
+        return model;
+    }
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, file) != -1)
+    {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL)
+        {
+            colon += 1 + strspn(colon + 1, " \t");
+            colon[strcspn(colon, "\n")] = '\0';
+            if (colon[0] != '\0')
+            {
+                snprintf(model, sizeof(model), "%s", colon);
+            }
+            break;
+        }
+    }
+    free(line);
+    fclose(file);
+    return model;
+}
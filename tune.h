@@ -0,0 +1,22 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stdbool.h>
+#include "goi.h"
+
+/**
+ * How to run worlds of one size fastest on one CPU: the GoiOptions fields the tuner tries.
+ */
+typedef struct
+{
+    int nThreads;
+    GoiSchedule schedule;
+    int chunkSize;
+    int tileCols;
+} Tuning;
+
+int runTuner(const char *inputPath, const GoiOptions *options, bool fixedRules, int maxThreads, const char *cachePath);
+int loadTuning(const char *cachePath, int nRows, int nCols, Tuning *tuning);
+const char *defaultTuningCache(void);
+
+#endif
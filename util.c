@@ -8,6 +8,7 @@
 
 #include "util.h"
 #include <stdio.h>
+#include <time.h>
 
 /**
  * returns the value at the input row and col of the input grid, if valid.
@@ -21,7 +22,7 @@ int getValueAt(const int *grid, int nRows, int nCols, int row, int col)
         return -1;
     }
 
-    return *(grid + (row * nCols) + col);
+    return *(grid + ((long) row * nCols) + col);
 }
 
 /**
@@ -36,7 +37,7 @@ void setValueAt(int *grid, int nRows, int nCols, int row, int col, int val)
         return;
     }
 
-    *(grid + (row * nCols) + col) = val;
+    *(grid + ((long) row * nCols) + col) = val;
 }
 
 /**
@@ -48,8 +49,20 @@ void printWorld(const int *world, int nRows, int nCols)
     {
         for (int col = 0; col < nCols; col++)
         {
-            printf("%d ", *(world + (row * nCols) + col));
+            printf("%d ", *(world + ((long) row * nCols) + col));
         }
         printf("\n");
     }
 }
+
+/**
+ * Returns the current time in seconds on a monotonic clock. Only differences between two calls are meaningful.
+ *
+ * Unlike clock(), which sums CPU time over every thread, this measures elapsed wall time.
+ */
+double getWallTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
@@ -4,5 +4,6 @@
 int getValueAt(const int *grid, int nRows, int nCols, int row, int col);
 void setValueAt(int *grid, int nRows, int nCols, int row, int col, int val);
 void printWorld(const int *world, int nRows, int nCols);
+double getWallTime(void);
 
 #endif
@@ -0,0 +1,162 @@
+/**
+ * The vector row kernels of one instruction set: nextRowSwarFor's algorithm with each cell in a 32-bit lane of
+ * a GCC vector as wide as the instruction set's registers, so that a block of cells is loaded, compared and
+ * stored by single instructions, with no packing into lanes and out of them.
+ *
+ * kernels.c includes this file once per instruction set, with VECTOR_SUFFIX (appended to every name defined
+ * here), VECTOR_TARGET (the target attribute the code is compiled for) and VECTOR_LANES (cells per vector)
+ * defined, which is why it has no include guard. Its kernels may only be run once the CPU is known to support
+ * the instruction set.
+ */
+
+#define Lanes VECTOR_NAME(Cells)
+#define VECTOR_FUNCTION static inline __attribute__((always_inline, target(VECTOR_TARGET)))
+
+typedef int32_t Lanes __attribute__((vector_size(4 * VECTOR_LANES)));
+
+// loadLanes loads the VECTOR_LANES cells from cells, which need not be aligned.
+VECTOR_FUNCTION Lanes VECTOR_NAME(loadLanes)(const int *cells)
+{
+    Lanes lanes;
+    memcpy(&lanes, cells, sizeof(lanes));
+    return lanes;
+}
+
+// lanesIn returns all ones in the lanes whose count has its bit set in counts, and 0 in the others.
+VECTOR_FUNCTION Lanes VECTOR_NAME(lanesIn)(Lanes lanes, unsigned counts)
+{
+    Lanes in = {0};
+    for (int count = 0; count <= MAX_NEIGHBORS; count++)
+    {
+        if (counts & (1u << count))
+        {
+            in |= lanes == count;
+        }
+    }
+    return in;
+}
+
+// countLanes returns how many lanes are set in mask, whose lanes are all ones (-1) or all zeros.
+VECTOR_FUNCTION long VECTOR_NAME(countLanes)(Lanes mask)
+{
+    long count = 0;
+    for (int k = 0; k < VECTOR_LANES; k++)
+    {
+        count -= mask[k];
+    }
+    return count;
+}
+
+/**
+ * Computes one row like nextRowFor, with the same arguments and results, VECTOR_LANES cells at a time.
+ *
+ * The neighbours of a block of cells are the blocks starting one cell to either side of it in its row and in
+ * the rows above and below, so a faction's neighbour counts are the sum of 8 comparisons of whole blocks.
+ * The rules are then applied through masks as in nextRowSwarFor. The cells past the last whole block are
+ * left to nextRowFor.
+ */
+VECTOR_FUNCTION long VECTOR_NAME(nextRowVectorFor)(const RuleTable *rules, const LiveFactions *live, const int *above,
+                                                   const int *row, const int *below, const int *invaders, int *next,
+                                                   int nCols, GoiPopulationStats *population, int nLive, CountMode mode)
+{
+    int nFactions = nLive <= 2 ? nLive : live->nFactions;
+    // -1 in a lane for every cell of it that died due to fighting, summed up once the row is done
+    Lanes deathLanes = {0};
+    int col = 0;
+    for (; col + VECTOR_LANES <= nCols; col += VECTOR_LANES)
+    {
+        Lanes upLeft = VECTOR_NAME(loadLanes)(above + col - 1);
+        Lanes up = VECTOR_NAME(loadLanes)(above + col);
+        Lanes upRight = VECTOR_NAME(loadLanes)(above + col + 1);
+        Lanes left = VECTOR_NAME(loadLanes)(row + col - 1);
+        Lanes cells = VECTOR_NAME(loadLanes)(row + col);
+        Lanes right = VECTOR_NAME(loadLanes)(row + col + 1);
+        Lanes downLeft = VECTOR_NAME(loadLanes)(below + col - 1);
+        Lanes down = VECTOR_NAME(loadLanes)(below + col);
+        Lanes downRight = VECTOR_NAME(loadLanes)(below + col + 1);
+        Lanes alive = cells != DEAD_FACTION;
+
+        Lanes counts[MAX_FACTIONS - 1];
+        Lanes total = {0};
+        Lanes friendly = {0};
+        for (int i = 0; i < nFactions; i++)
+        {
+            int faction = live->factions[i];
+            // a comparison is -1 in the lanes where it holds
+            counts[i] = -((upLeft == faction) + (up == faction) + (upRight == faction) + (left == faction) +
+                          (right == faction) + (downLeft == faction) + (down == faction) + (downRight == faction));
+            total += counts[i];
+            friendly |= counts[i] & (cells == faction);
+        }
+
+        Lanes fought = alive & (total - friendly >= rules->fightThreshold);
+        Lanes survives = alive & ~fought & VECTOR_NAME(lanesIn)(friendly, rules->survivalCounts);
+        Lanes nextCells = cells & survives;
+        Lanes vacant = ~alive;
+        for (int i = 0; i < nFactions; i++)
+        {
+            // factions are in ascending order, so the highest birthable one is written last and wins
+            Lanes born = vacant & VECTOR_NAME(lanesIn)(counts[i], rules->birthCounts);
+            nextCells = (nextCells & ~born) | (live->factions[i] & born);
+        }
+
+        Lanes landed = {0};
+        if (invaders != NULL)
+        {
+            Lanes invading = VECTOR_NAME(loadLanes)(invaders + col);
+            landed = (invading != DEAD_FACTION) & (rules->invasionPolicy == GOI_INVASION_OVERRIDE ? alive | vacant : vacant);
+            nextCells = (nextCells & ~landed) | (invading & landed);
+            fought = (fought & ~landed) | (landed & alive);
+        }
+
+        memcpy(next + col, &nextCells, sizeof(nextCells));
+        deathLanes += fought;
+
+        if (mode != COUNT_NOTHING)
+        {
+            long nLiveCells = 0;
+            for (int i = 0; i < nFactions; i++)
+            {
+                int faction = live->factions[i];
+                Lanes becomes = nextCells == faction;
+                long nBecome = VECTOR_NAME(countLanes)(becomes);
+                population->live[faction] += nBecome;
+                nLiveCells += nBecome;
+                if (mode == COUNT_ALL)
+                {
+                    Lanes was = (cells == faction) & alive;
+                    population->births[faction] += VECTOR_NAME(countLanes)(becomes & vacant & ~landed);
+                    population->landed[faction] += VECTOR_NAME(countLanes)(becomes & landed);
+                    population->fightingDeaths[faction] += VECTOR_NAME(countLanes)(was & fought);
+                    population->naturalDeaths[faction] += VECTOR_NAME(countLanes)(was & ~fought & ~landed & ~survives);
+                }
+            }
+            population->live[DEAD_FACTION] += VECTOR_LANES - nLiveCells;
+        }
+    }
+
+    long deaths = VECTOR_NAME(countLanes)(deathLanes);
+    if (col < nCols)
+    {
+        deaths += nextRowFor(rules, live, above + col, row + col, below + col, invaders == NULL ? NULL : invaders + col,
+                             next + col, nCols - col, population, nLive, mode, false);
+    }
+    return deaths;
+}
+
+// the wrappers, as for the other kinds of kernel
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowSingle), VECTOR_NAME(nextRowVectorFor), 1, COUNT_NOTHING)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowPair), VECTOR_NAME(nextRowVectorFor), 2, COUNT_NOTHING)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowGeneral), VECTOR_NAME(nextRowVectorFor), MAX_FACTIONS - 1, COUNT_NOTHING)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowSingleLive), VECTOR_NAME(nextRowVectorFor), 1, COUNT_LIVE)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowPairLive), VECTOR_NAME(nextRowVectorFor), 2, COUNT_LIVE)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowGeneralLive), VECTOR_NAME(nextRowVectorFor), MAX_FACTIONS - 1, COUNT_LIVE)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowSingleCounting), VECTOR_NAME(nextRowVectorFor), 1, COUNT_ALL)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowPairCounting), VECTOR_NAME(nextRowVectorFor), 2, COUNT_ALL)
+__attribute__((target(VECTOR_TARGET))) ROW_KERNEL(VECTOR_NAME(nextRowGeneralCounting), VECTOR_NAME(nextRowVectorFor), MAX_FACTIONS - 1, COUNT_ALL)
+
+#undef VECTOR_FUNCTION
+#undef Lanes
+#undef VECTOR_SUFFIX
+#undef VECTOR_TARGET
+#undef VECTOR_LANES